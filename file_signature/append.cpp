@@ -0,0 +1,147 @@
+#include <file_signature/file_signature.h>
+#include <file_signature/file_signature_impl.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <optional>
+#include <string>
+
+namespace file_signature {
+
+namespace {
+
+// file_size is zero-padded so the header keeps its length as the file grows
+// and an append rewrites only the tail of the signature
+constexpr std::size_t file_size_width = 20;
+
+signature_header append_header(const file_identity& id, int block_size,
+                               const digest_set& digests) {
+  auto size = std::to_string(id.size);
+  size.insert(0, file_size_width - size.size(), '0');
+
+  return {{"mode", "full"},
+          {"block_size", std::to_string(block_size)},
+          {"digests", digest_columns(digests)},
+          {"dev", std::to_string(id.dev)},
+          {"ino", std::to_string(id.ino)},
+          {"file_size", size}};
+}
+
+// blocks of the earlier signature which the input still starts with; 0 when
+// the input was replaced, shrunk or differs in a checked block
+std::uint64_t matching_blocks(const std::string& input_file,
+                              const file_identity& id, int block_size,
+                              const options& opts, signature& old) {
+  auto& h = old.header;
+  auto expected = append_header(id, block_size, opts.digests);
+  for (auto key : {"mode", "block_size", "digests", "dev", "ino"}) {
+    if (h[key] != expected[key]) {
+      return 0;
+    }
+  }
+
+  const auto& size = h["file_size"];
+  if (size.empty() || size.size() > file_size_width ||
+      !std::all_of(size.begin(), size.end(),
+                   [](unsigned char c) { return std::isdigit(c); })) {
+    return 0;
+  }
+
+  std::uint64_t old_size = std::stoull(size);
+  std::uint64_t bs = block_size;
+  auto blocks = (old_size + bs - 1) / bs;
+  if (old_size > id.size || old.crc32.size() != blocks || blocks == 0) {
+    return 0;
+  }
+
+  std::ifstream s;
+  try {
+    s.exceptions(std::ifstream::badbit | std::ios_base::failbit);
+    s.open(input_file, std::ios::binary | std::ios::in);
+    s.exceptions(std::ifstream::badbit);
+  } catch (std::exception& e) {
+    std::throw_with_nested(error("Couldn't open " + input_file));
+  }
+
+  sample_options checked;
+  checked.count = opts.append_check_blocks;
+  checked.seed = old_size;
+
+  for (auto i : sample_blocks(blocks, checked)) {
+    file_block b(std::min(bs, old_size - i * bs), 0);
+    s.seekg(i * bs);
+    s.read(b.data(), b.size());
+    if (!s) {
+      return 0;
+    }
+
+    auto d = calc_block_digests(b.data(), b.size(), opts.digests, nullptr);
+    if (d.crc32 != old.crc32[i] ||
+        (opts.digests.crc32c && d.crc32c != old.crc32c[i]) ||
+        (opts.digests.xxh64 && d.xxh64 != old.xxh64[i])) {
+      return 0;
+    }
+  }
+
+  // a partial last block is hashed again together with the new bytes
+  return old_size / bs;
+}
+
+// byte offset of the line of the signature file, the header is line 0
+std::uint64_t line_offset(const std::string& signature_file,
+                          std::uint64_t line) {
+  std::ifstream s;
+  s.exceptions(std::ifstream::badbit | std::ios_base::failbit);
+  s.open(signature_file, std::ios::binary | std::ios::in);
+
+  std::string l;
+  for (std::uint64_t i = 0; i < line; i++) {
+    std::getline(s, l);
+  }
+  return s.tellg();
+}
+
+}  // namespace
+
+void generator::append() {
+  if (opts.shard || opts.digests.sha256 || !opts.cache_dir.empty()) {
+    throw error("append can't be combined with shards, sha256 or the cache");
+  }
+
+  auto id = stat_identity(input_file);
+  auto header = append_header(id, block_size, opts.digests);
+
+  std::uint64_t kept = 0;
+  if (std::filesystem::exists(signature_file)) {
+    std::optional<signature> old;
+    try {
+      old = read_signature(signature_file);
+    } catch (std::exception& e) {
+      // cut short by an interrupted run, the whole file is signed again
+    }
+
+    if (old) {
+      kept = matching_blocks(input_file, id, block_size, opts, *old);
+    }
+  }
+
+  if (kept > 0 &&
+      line_offset(signature_file, 1) == format_header(header).size() + 1) {
+    std::uint64_t offset = kept * block_size;
+    if (offset == id.size) {
+      return;
+    }
+
+    sign_range(std::move(header), offset, id.size - offset,
+               line_offset(signature_file, kept + 1));
+    return;
+  }
+
+  sign_range(std::move(header), 0, id.size);
+}
+
+}  // namespace file_signature
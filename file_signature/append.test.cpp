@@ -0,0 +1,218 @@
+#include <file_signature/file_signature.h>
+#include <file_signature/file_signature.test.h>
+#include <file_signature/file_signature_impl.h>
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+file_signature::options append_options() {
+  file_signature::options opts;
+  opts.append = true;
+  return opts;
+}
+
+void append_to_input(std::size_t size, char c) {
+  std::ofstream s{file_signature::default_input_file,
+                  std::ios::binary | std::ios::app};
+  s << std::string(size, c);
+}
+
+// blocks of a plain generate() run, the signature an append must end with
+std::vector<std::string> full_blocks() {
+  file_signature::generate(file_signature::default_input_file,
+                           "append_full.signature", 10);
+  auto lines = file_signature::read_file("append_full.signature");
+  file_signature::delete_file_for_reader("append_full.signature");
+  return lines;
+}
+
+std::vector<std::string> signature_blocks() {
+  auto lines = file_signature::read_file(file_signature::default_output_file);
+  return {lines.begin() + 1, lines.end()};
+}
+
+}  // namespace
+
+TEST(Append, HashesOnlyNewBlocks) {
+  try {
+    file_signature::delete_file_for_reader(
+        file_signature::default_output_file);
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           95, 'c');
+    file_signature::stats st;
+
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10,
+                             append_options(), &st);
+    EXPECT_EQ(10, st.blocks);
+    EXPECT_EQ(full_blocks(), signature_blocks());
+
+    append_to_input(50, 'd');
+    st = {};
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10,
+                             append_options(), &st);
+    // the partial block 9 and the blocks 10 to 14
+    EXPECT_EQ(6, st.blocks);
+    EXPECT_EQ(55, st.bytes);
+    EXPECT_EQ(full_blocks(), signature_blocks());
+
+    file_signature::signature_header h;
+    ASSERT_TRUE(file_signature::parse_header(
+        file_signature::read_file(file_signature::default_output_file)[0], h));
+    EXPECT_EQ(145, std::stoull(h["file_size"]));
+
+    st = {};
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10,
+                             append_options(), &st);
+    EXPECT_EQ(1, st.blocks);
+    EXPECT_EQ(full_blocks(), signature_blocks());
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+}
+
+TEST(Append, WithDigests) {
+  try {
+    file_signature::delete_file_for_reader(
+        file_signature::default_output_file);
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           40, 'c');
+    auto opts = append_options();
+    opts.digests.crc32c = true;
+    opts.digests.xxh64 = true;
+
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10, opts);
+    append_to_input(25, 'd');
+    file_signature::stats st;
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10, opts,
+                             &st);
+    EXPECT_EQ(3, st.blocks);
+
+    auto appended = file_signature::read_signature(
+        file_signature::default_output_file);
+    opts.append = false;
+    file_signature::generate(file_signature::default_input_file,
+                             "append_full.signature", 10, opts);
+    auto full = file_signature::read_signature("append_full.signature");
+
+    EXPECT_EQ(full.crc32, appended.crc32);
+    EXPECT_EQ(full.crc32c, appended.crc32c);
+    EXPECT_EQ(full.xxh64, appended.xxh64);
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+
+  file_signature::delete_file_for_reader("append_full.signature");
+}
+
+TEST(Append, TruncatedSignatureIsSignedAgain) {
+  try {
+    file_signature::delete_file_for_reader(
+        file_signature::default_output_file);
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           95, 'c');
+    auto opts = append_options();
+    opts.digests.crc32c = true;
+    opts.digests.xxh64 = true;
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10, opts);
+
+    // the last line loses its xxh64 column
+    auto size = std::filesystem::file_size(file_signature::default_output_file);
+    std::filesystem::resize_file(file_signature::default_output_file,
+                                 size - 22);
+    append_to_input(10, 'd');
+
+    file_signature::stats st;
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10, opts,
+                             &st);
+    EXPECT_EQ(11, st.blocks);
+
+    auto appended = file_signature::read_signature(
+        file_signature::default_output_file);
+    opts.append = false;
+    file_signature::generate(file_signature::default_input_file,
+                             "append_full.signature", 10, opts);
+    auto full = file_signature::read_signature("append_full.signature");
+
+    EXPECT_EQ(full.crc32, appended.crc32);
+    EXPECT_EQ(full.crc32c, appended.crc32c);
+    EXPECT_EQ(full.xxh64, appended.xxh64);
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+
+  file_signature::delete_file_for_reader("append_full.signature");
+}
+
+TEST(Append, ChangedPrefixIsSignedAgain) {
+  try {
+    file_signature::delete_file_for_reader(
+        file_signature::default_output_file);
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           95, 'c');
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10,
+                             append_options());
+
+    // the last block the earlier run covered is always checked
+    std::fstream f(file_signature::default_input_file,
+                   std::ios::binary | std::ios::in | std::ios::out);
+    f.seekp(92);
+    f << 'x';
+    f.close();
+    append_to_input(10, 'd');
+
+    file_signature::stats st;
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10,
+                             append_options(), &st);
+    EXPECT_EQ(11, st.blocks);
+    EXPECT_EQ(full_blocks(), signature_blocks());
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+}
+
+TEST(Append, PlainSignatureIsSignedAgain) {
+  try {
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           95, 'c');
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10);
+
+    file_signature::stats st;
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10,
+                             append_options(), &st);
+    EXPECT_EQ(10, st.blocks);
+    EXPECT_EQ(full_blocks(), signature_blocks());
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+}
+
+TEST(Append, WithSha256) {
+  file_signature::create_file_for_reader(file_signature::default_input_file,
+                                         95, 'c');
+  auto opts = append_options();
+  opts.digests.sha256 = true;
+
+  try {
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10, opts);
+    FAIL() << "expected to throw an exception";
+  } catch (std::exception& e) {
+    SUCCEED();
+  }
+}
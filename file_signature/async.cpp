@@ -0,0 +1,372 @@
+#include <file_signature/file_signature.h>
+#include <file_signature/file_signature_impl.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <ios>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace file_signature {
+
+std::future<void> generate_async(std::string input_file,
+                                 std::string signature_file, int block_size,
+                                 executor ex) {
+  auto job = std::make_shared<async_job>(input_file, signature_file,
+                                         block_size, options{}, std::move(ex));
+  return job->start();
+}
+
+void generate_async(std::string input_file, std::string signature_file,
+                    int block_size, executor ex, completion on_done) {
+  auto job = std::make_shared<async_job>(input_file, signature_file,
+                                         block_size, options{}, std::move(ex));
+  job->start(std::move(on_done));
+}
+
+//
+// async_job
+//
+
+constexpr int async_job::max_in_flight;
+
+async_job::async_job(std::string input_file, std::string signature_file,
+                     int block_size, options opts, executor ex,
+                     job_scheduler* scheduler)
+    : input_file{input_file},
+      signature_file{signature_file},
+      block_size{block_size},
+      opts{opts},
+      ex{std::move(ex)},
+      scheduler{scheduler},
+      remaining{opts.length},
+      in_flight{0},
+      read_paused{false},
+      reader_finished{false},
+      finished{false} {}
+
+std::future<void> async_job::start() {
+  auto f = result.get_future();
+  post([this]() { begin(); });
+  return f;
+}
+
+void async_job::start(completion on_done) {
+  this->on_done = std::move(on_done);
+  post([this]() { begin(); });
+}
+
+void async_job::cancel() {
+  fail(std::make_exception_ptr(error("generate cancelled: " + input_file)));
+}
+
+void async_job::begin() {
+  try {
+    if (opts.shard) {
+      sig.header = shard_header(input_file, block_size, opts);
+    }
+
+    if (!opts.cache_dir.empty()) {
+      cache.emplace(input_file, block_size, opts);
+      if (cache->lookup(signature_file)) {
+        finish();
+        return;
+      }
+    }
+
+    try {
+      s.exceptions(std::ifstream::badbit | std::ios_base::failbit);
+      s.open(input_file, std::ios::binary | std::ios::in);
+      s.seekg(opts.offset);
+      s.exceptions(std::ifstream::badbit);
+    } catch (std::exception& e) {
+      std::throw_with_nested(error("Couldn't open " + input_file));
+    }
+  } catch (std::exception& e) {
+    fail();
+    return;
+  }
+
+  request_read();
+}
+
+void async_job::post(std::function<void()> step) {
+  auto self = shared_from_this();
+  ex([self, step = std::move(step)]() {
+    // the job must end even when a step throws outside its own error
+    // handling, or its future would never be ready
+    try {
+      step();
+    } catch (...) {
+      self->fail();
+    }
+  });
+}
+
+void async_job::request_read() {
+  if (!scheduler) {
+    post([this]() { read(); });
+    return;
+  }
+
+  auto self = shared_from_this();
+  scheduler->request_read(block_size, [self]() {
+    self->post([self]() { self->read(); });
+  });
+}
+
+void async_job::read() {
+  std::unique_lock lk{mt};
+  bool stopped = finished;
+  lk.unlock();
+
+  // a cancelled job still gives back the read it was admitted for
+  if (stopped) {
+    if (scheduler) {
+      scheduler->finish_read();
+      scheduler->release(block_size);
+    }
+    return;
+  }
+
+  file_block buffer;
+  try {
+    std::size_t size = block_size;
+    if (opts.length > 0) {
+      size = std::min<std::uint64_t>(size, remaining);
+    }
+
+    buffer = scheduler ? scheduler->acquire_buffer(size) : file_block(size, 0);
+    s.read(buffer.data(), buffer.size());
+    if (s.eof()) {
+      buffer.resize(s.gcount());
+    }
+  } catch (std::exception& e) {
+    if (scheduler) {
+      scheduler->finish_read();
+    }
+    release_block(std::move(buffer));
+    fail();
+    return;
+  }
+
+  if (scheduler) {
+    scheduler->finish_read();
+  }
+  if (opts.digests.sha256) {
+    file_sha256.update(buffer.data(), buffer.size());
+  }
+
+  lk.lock();
+  if (finished) {
+    lk.unlock();
+    release_block(std::move(buffer));
+    return;
+  }
+
+  auto index = sig.crc32.size();
+  bool post_hash = !buffer.empty();
+  if (post_hash) {
+    sig.crc32.push_back(0);
+    if (opts.digests.crc32c) {
+      sig.crc32c.push_back(0);
+    }
+    if (opts.digests.xxh64) {
+      sig.xxh64.push_back(0);
+    }
+    in_flight++;
+  }
+
+  if (opts.length > 0) {
+    remaining -= buffer.size();
+  }
+
+  bool post_read = false;
+  bool post_write = false;
+  if (!s || (opts.length > 0 && remaining == 0)) {
+    reader_finished = true;
+    post_write = in_flight == 0;
+  } else if (in_flight >= max_in_flight) {
+    read_paused = true;
+  } else {
+    post_read = true;
+  }
+  lk.unlock();
+
+  if (post_hash) {
+    post([this, index, b = std::move(buffer)]() mutable {
+      hash(index, std::move(b));
+    });
+  } else {
+    release_block(std::move(buffer));
+  }
+  if (post_read) {
+    request_read();
+  }
+  if (post_write) {
+    post([this]() { write(); });
+  }
+}
+
+void async_job::hash(std::size_t index, file_block b) {
+  auto d = calc_block_digests(b.data(), b.size(), opts.digests, nullptr);
+  release_block(std::move(b));
+
+  std::unique_lock lk{mt};
+  if (finished) {
+    return;
+  }
+
+  sig.crc32[index] = d.crc32;
+  if (opts.digests.crc32c) {
+    sig.crc32c[index] = d.crc32c;
+  }
+  if (opts.digests.xxh64) {
+    sig.xxh64[index] = d.xxh64;
+  }
+  in_flight--;
+
+  bool post_read = read_paused;
+  bool post_write = reader_finished && in_flight == 0;
+  read_paused = false;
+  lk.unlock();
+
+  if (post_read) {
+    request_read();
+  }
+  if (post_write) {
+    post([this]() { write(); });
+  }
+}
+
+void async_job::write() {
+  std::unique_lock lk{mt};
+  if (finished) {
+    return;
+  }
+  lk.unlock();
+
+  try {
+    finish_header(sig, opts.digests, &file_sha256);
+    write_signature(signature_file, sig);
+
+    if (cache) {
+      cache->store(signature_file);
+    }
+  } catch (std::exception& e) {
+    fail();
+    return;
+  }
+
+  finish();
+}
+
+void async_job::release_block(file_block b) {
+  if (scheduler) {
+    scheduler->release(block_size);
+    scheduler->recycle_buffer(std::move(b));
+  }
+}
+
+void async_job::finish() {
+  std::unique_lock lk{mt};
+  if (finished) {
+    return;
+  }
+  finished = true;
+  lk.unlock();
+
+  if (on_done) {
+    ex([on_done = std::move(on_done)]() { on_done(nullptr); });
+  } else {
+    result.set_value();
+  }
+}
+
+void async_job::fail() {
+  try {
+    std::throw_with_nested(error("generate error: " + input_file));
+  } catch (...) {
+    fail(std::current_exception());
+  }
+}
+
+void async_job::fail(std::exception_ptr e) {
+  std::unique_lock lk{mt};
+  if (finished) {
+    return;
+  }
+  finished = true;
+  lk.unlock();
+
+  if (on_done) {
+    ex([on_done = std::move(on_done), e]() { on_done(e); });
+  } else {
+    result.set_exception(e);
+  }
+}
+
+//
+// thread_pool
+//
+
+thread_pool::thread_pool(unsigned threads) : stopping{false} {
+  for (unsigned i = 0; i < std::max(threads, 1u); i++) {
+    this->threads.emplace_back([this]() { run(); });
+  }
+}
+
+thread_pool::~thread_pool() {
+  std::unique_lock lk{mt};
+  stopping = true;
+  lk.unlock();
+  cv.notify_all();
+
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+void thread_pool::post(std::function<void()> task) {
+  std::unique_lock lk{mt};
+  tasks.push_back(std::move(task));
+  lk.unlock();
+  cv.notify_one();
+}
+
+executor thread_pool::get_executor() {
+  return [this](std::function<void()> task) { post(std::move(task)); };
+}
+
+void thread_pool::run() {
+  while (true) {
+    std::unique_lock lk{mt};
+
+    if (tasks.empty()) {
+      if (stopping) {
+        break;
+      }
+
+      cv.wait(lk);
+      continue;
+    }
+
+    auto task = std::move(tasks.front());
+    tasks.pop_front();
+    lk.unlock();
+
+    try {
+      task();
+    } catch (...) {
+      // a task reports its failures through its own future
+    }
+  }
+}
+
+}  // namespace file_signature
@@ -0,0 +1,129 @@
+#include <file_signature/file_signature.h>
+#include <file_signature/file_signature.test.h>
+#include <gtest/gtest.h>
+
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(GenerateAsync, EmptyFile) {
+  try {
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           0, 'c');
+    file_signature::thread_pool pool{2};
+
+    file_signature::generate_async(file_signature::default_input_file,
+                                   file_signature::default_output_file, 10,
+                                   pool.get_executor())
+        .get();
+
+    auto lines = file_signature::read_file(file_signature::default_output_file);
+    ASSERT_EQ(0, lines.size());
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+}
+
+TEST(GenerateAsync, SameAsGenerate) {
+  try {
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           1005, 'c');
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10);
+    auto expected =
+        file_signature::read_file(file_signature::default_output_file);
+
+    file_signature::thread_pool pool{3};
+    file_signature::generate_async(file_signature::default_input_file,
+                                   "async.signature", 10, pool.get_executor())
+        .get();
+
+    auto lines = file_signature::read_file("async.signature");
+    ASSERT_EQ(101, lines.size());
+    EXPECT_EQ(expected, lines);
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+
+  file_signature::delete_file_for_reader("async.signature");
+}
+
+TEST(GenerateAsync, ManyJobsOnOneThread) {
+  try {
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           95, 'c');
+    file_signature::thread_pool pool{1};
+
+    std::vector<std::future<void>> jobs;
+    for (int i = 0; i < 20; i++) {
+      jobs.push_back(file_signature::generate_async(
+          file_signature::default_input_file,
+          "async" + std::to_string(i) + ".signature", 10,
+          pool.get_executor()));
+    }
+
+    for (int i = 0; i < 20; i++) {
+      jobs[i].get();
+      auto name = "async" + std::to_string(i) + ".signature";
+      EXPECT_EQ(10, file_signature::read_file(name).size());
+      file_signature::delete_file_for_reader(name);
+    }
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+}
+
+TEST(GenerateAsync, NotExistingFile) {
+  file_signature::delete_file_for_reader(file_signature::default_input_file);
+  file_signature::thread_pool pool{2};
+
+  auto result = file_signature::generate_async(
+      file_signature::default_input_file, file_signature::default_output_file,
+      10, pool.get_executor());
+
+  try {
+    result.get();
+    FAIL() << "expected to throw an exception";
+  } catch (std::exception& e) {
+    SUCCEED();
+  }
+}
+
+TEST(GenerateAsync, Completion) {
+  try {
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           95, 'c');
+    file_signature::thread_pool pool{2};
+    std::promise<std::thread::id> done;
+
+    file_signature::generate_async(
+        file_signature::default_input_file, file_signature::default_output_file,
+        10, pool.get_executor(), [&done](std::exception_ptr e) {
+          if (e) {
+            done.set_exception(e);
+          } else {
+            done.set_value(std::this_thread::get_id());
+          }
+        });
+
+    EXPECT_NE(std::this_thread::get_id(), done.get_future().get());
+    EXPECT_EQ(10, file_signature::read_file(file_signature::default_output_file)
+                      .size());
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+}
+
+TEST(GenerateAsync, CompletionWithError) {
+  file_signature::delete_file_for_reader(file_signature::default_input_file);
+  file_signature::thread_pool pool{2};
+  std::promise<std::exception_ptr> done;
+
+  file_signature::generate_async(
+      file_signature::default_input_file, file_signature::default_output_file,
+      10, pool.get_executor(),
+      [&done](std::exception_ptr e) { done.set_value(e); });
+
+  EXPECT_TRUE(done.get_future().get());
+}
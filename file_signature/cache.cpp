@@ -0,0 +1,219 @@
+#include <file_signature/file_signature.h>
+#include <file_signature/file_signature_impl.h>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace file_signature {
+
+namespace {
+
+const char entry_suffix[] = ".signature";
+const char tmp_infix[] = ".tmp.";
+
+// coarsest timestamp granularity of the usual filesystems (FAT); a write
+// within it of the last one may leave the mtime unchanged
+constexpr std::int64_t mtime_granularity_ns = 2000000000;
+
+// a store() copies one signature, a "<key>.tmp.<pid>.<n>" file older than
+// this was left by a process that died; pids can't tell, the cache may be
+// shared across pid namespaces and hosts
+constexpr auto orphaned_tmp_age = std::chrono::minutes(10);
+
+bool orphaned_tmp(const fs::directory_entry& e, fs::file_time_type now) {
+  if (e.path().filename().string().find(tmp_infix) == std::string::npos) {
+    return false;
+  }
+
+  std::error_code ec;
+  auto written = e.last_write_time(ec);
+  return !ec && now - written > orphaned_tmp_age;
+}
+
+std::atomic<std::uint64_t> tmp_counter{0};
+
+}  // namespace
+
+file_identity stat_identity(const std::string& file) {
+  struct stat st;
+  if (::stat(file.c_str(), &st) < 0) {
+    throw error("Couldn't stat " + file + ": " + std::strerror(errno));
+  }
+
+  return {static_cast<std::uint64_t>(st.st_dev),
+          static_cast<std::uint64_t>(st.st_ino),
+          static_cast<std::uint64_t>(st.st_size),
+          st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec};
+}
+
+//
+// signature_cache
+//
+
+signature_cache::signature_cache(std::string dir, std::uint64_t limit)
+    : dir{dir}, limit{limit} {
+  try {
+    fs::create_directories(dir);
+  } catch (std::exception& e) {
+    std::throw_with_nested(error("Couldn't create cache " + dir));
+  }
+}
+
+std::string signature_cache::key(const file_identity& id, int block_size,
+                                 const options& opts) {
+  auto columns = digest_columns(opts.digests);
+  std::replace(columns.begin(), columns.end(), ',', '+');
+
+  auto k = std::to_string(id.dev) + '-' + std::to_string(id.ino) + '-' +
+           std::to_string(id.size) + '-' + std::to_string(id.mtime_ns) + '-' +
+           std::to_string(block_size) + '-' + columns;
+  if (opts.digests.sha256) {
+    k += "+sha256";
+  }
+  if (opts.shard) {
+    k += "-shard" + std::to_string(opts.offset) + '+' +
+         std::to_string(opts.length);
+  }
+  return k;
+}
+
+bool signature_cache::cacheable(const file_identity& id) {
+  auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::system_clock::now().time_since_epoch())
+                 .count();
+  return now - id.mtime_ns >= mtime_granularity_ns;
+}
+
+bool signature_cache::lookup(const std::string& key,
+                             const std::string& signature_file) {
+  auto entry = fs::path{dir} / (key + entry_suffix);
+
+  // a concurrent eviction may remove the entry at any moment, that's a miss
+  std::error_code ec;
+  fs::copy_file(entry, signature_file, fs::copy_options::overwrite_existing,
+                ec);
+  if (ec) {
+    return false;
+  }
+
+  fs::last_write_time(entry, fs::file_time_type::clock::now(), ec);
+  return true;
+}
+
+bool signature_cache::store(const std::string& key,
+                            const std::string& signature_file) {
+  auto entry = fs::path{dir} / (key + entry_suffix);
+  auto tmp = fs::path{dir} / (key + tmp_infix + std::to_string(getpid()) +
+                              '.' + std::to_string(tmp_counter++));
+
+  std::error_code ec;
+  fs::copy_file(signature_file, tmp, fs::copy_options::overwrite_existing, ec);
+  if (!ec) {
+    fs::rename(tmp, entry, ec);
+  }
+  if (ec) {
+    fs::remove(tmp, ec);
+    return false;
+  }
+
+  if (limit > 0) {
+    try {
+      evict();
+    } catch (std::exception& e) {
+      // the entry is stored, the next store() evicts again
+    }
+  }
+  return true;
+}
+
+//
+// cached_input
+//
+
+cached_input::cached_input(std::string input_file, int block_size,
+                           const options& opts)
+    : cache{opts.cache_dir, opts.cache_limit},
+      input_file{std::move(input_file)},
+      identity{stat_identity(this->input_file)},
+      key{signature_cache::key(identity, block_size, opts)} {}
+
+bool cached_input::lookup(const std::string& signature_file) {
+  return cache.lookup(key, signature_file);
+}
+
+void cached_input::store(const std::string& signature_file) {
+  if (signature_cache::cacheable(identity) &&
+      stat_identity(input_file) == identity) {
+    cache.store(key, signature_file);
+  }
+}
+
+void signature_cache::evict() {
+  auto lock_file = (fs::path{dir} / ".lock").string();
+  int fd = open(lock_file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    throw error("Couldn't open " + lock_file + ": " + std::strerror(errno));
+  }
+  std::shared_ptr<void> fd_closer{nullptr, [fd](void*) { close(fd); }};
+
+  // one process evicts at a time, the others would remove the same entries
+  if (flock(fd, LOCK_EX) < 0) {
+    throw error("Couldn't lock " + lock_file + ": " + std::strerror(errno));
+  }
+
+  std::vector<std::tuple<fs::file_time_type, std::uint64_t, fs::path>> entries;
+  std::uint64_t total = 0;
+  std::error_code ec;
+  auto now = fs::file_time_type::clock::now();
+
+  for (const auto& e : fs::directory_iterator{dir, ec}) {
+    if (orphaned_tmp(e, now)) {
+      fs::remove(e.path(), ec);
+      continue;
+    }
+
+    auto name = e.path().filename().string();
+    if (name.size() < sizeof(entry_suffix) - 1 ||
+        name.compare(name.size() - (sizeof(entry_suffix) - 1),
+                     std::string::npos, entry_suffix) != 0) {
+      continue;
+    }
+
+    auto size = e.file_size(ec);
+    auto used = e.last_write_time(ec);
+    if (ec) {
+      continue;
+    }
+
+    entries.emplace_back(used, size, e.path());
+    total += size;
+  }
+
+  std::sort(entries.begin(), entries.end());
+
+  for (const auto& e : entries) {
+    if (total <= limit) {
+      break;
+    }
+    fs::remove(std::get<2>(e), ec);
+    total -= std::get<1>(e);
+  }
+}
+
+}  // namespace file_signature
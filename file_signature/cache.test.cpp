@@ -0,0 +1,230 @@
+#include <file_signature/file_signature.h>
+#include <file_signature/file_signature.test.h>
+#include <file_signature/file_signature_impl.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+namespace {
+
+const char cache_dir[] = "test_cache";
+
+file_signature::options cache_options(std::uint64_t limit = 0) {
+  file_signature::options opts;
+  opts.cache_dir = cache_dir;
+  opts.cache_limit = limit;
+  return opts;
+}
+
+// an input modified just now isn't cached
+void backdate(const std::string& name) {
+  std::filesystem::last_write_time(
+      name,
+      std::filesystem::file_time_type::clock::now() - std::chrono::hours(1));
+}
+
+std::size_t cache_entries() {
+  std::size_t n = 0;
+  for (const auto& e : std::filesystem::directory_iterator{cache_dir}) {
+    n += e.path().extension() == ".signature";
+  }
+  return n;
+}
+
+}  // namespace
+
+TEST(Cache, MissThenHit) {
+  std::filesystem::remove_all(cache_dir);
+
+  try {
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           20, 'c');
+    backdate(file_signature::default_input_file);
+    file_signature::stats st;
+
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10,
+                             cache_options(), &st);
+    EXPECT_EQ(0, st.cache_hits);
+    EXPECT_EQ(1, st.cache_misses);
+    EXPECT_EQ(2, st.blocks);
+    auto expected =
+        file_signature::read_file(file_signature::default_output_file);
+
+    file_signature::delete_file_for_reader(
+        file_signature::default_output_file);
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10,
+                             cache_options(), &st);
+    EXPECT_EQ(1, st.cache_hits);
+    EXPECT_EQ(1, st.cache_misses);
+    // the input wasn't read again
+    EXPECT_EQ(2, st.blocks);
+    EXPECT_EQ(expected,
+              file_signature::read_file(file_signature::default_output_file));
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+
+  std::filesystem::remove_all(cache_dir);
+}
+
+TEST(Cache, ChangedFileOrBlockSizeMisses) {
+  std::filesystem::remove_all(cache_dir);
+
+  try {
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           20, 'c');
+    backdate(file_signature::default_input_file);
+    file_signature::stats st;
+
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10,
+                             cache_options(), &st);
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 5,
+                             cache_options(), &st);
+    EXPECT_EQ(0, st.cache_hits);
+    EXPECT_EQ(4, file_signature::read_file(file_signature::default_output_file)
+                     .size());
+
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           30, 'c');
+    backdate(file_signature::default_input_file);
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10,
+                             cache_options(), &st);
+    EXPECT_EQ(0, st.cache_hits);
+    EXPECT_EQ(3, st.cache_misses);
+    EXPECT_EQ(3, file_signature::read_file(file_signature::default_output_file)
+                     .size());
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+
+  std::filesystem::remove_all(cache_dir);
+}
+
+TEST(Cache, LeastRecentlyUsedIsEvicted) {
+  std::filesystem::remove_all(cache_dir);
+
+  try {
+    for (auto name : {"cache1.txt", "cache2.txt", "cache3.txt"}) {
+      file_signature::create_file_for_reader(name, 100, 'c');
+      backdate(name);
+    }
+
+    // a signature of 10 blocks takes about 120 bytes, two of them fit
+    auto opts = cache_options(250);
+    file_signature::stats st;
+
+    file_signature::generate("cache1.txt", "cache.signature", 10, opts, &st);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    file_signature::generate("cache2.txt", "cache.signature", 10, opts, &st);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    file_signature::generate("cache1.txt", "cache.signature", 10, opts, &st);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    file_signature::generate("cache3.txt", "cache.signature", 10, opts, &st);
+    EXPECT_EQ(1, st.cache_hits);
+    EXPECT_EQ(2, cache_entries());
+
+    file_signature::generate("cache1.txt", "cache.signature", 10, opts, &st);
+    EXPECT_EQ(2, st.cache_hits);
+    file_signature::generate("cache2.txt", "cache.signature", 10, opts, &st);
+    EXPECT_EQ(2, st.cache_hits);
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+
+  for (auto name : {"cache1.txt", "cache2.txt", "cache3.txt",
+                    "cache.signature"}) {
+    file_signature::delete_file_for_reader(name);
+  }
+  std::filesystem::remove_all(cache_dir);
+}
+
+TEST(Cache, RecentlyModifiedIsNotStored) {
+  std::filesystem::remove_all(cache_dir);
+
+  try {
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           20, 'c');
+    file_signature::stats st;
+
+    for (int i = 0; i < 2; i++) {
+      file_signature::generate(file_signature::default_input_file,
+                               file_signature::default_output_file, 10,
+                               cache_options(), &st);
+    }
+    EXPECT_EQ(0, st.cache_hits);
+    EXPECT_EQ(2, st.cache_misses);
+    EXPECT_EQ(0, cache_entries());
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+
+  std::filesystem::remove_all(cache_dir);
+}
+
+TEST(Cache, OrphanedTmpIsEvicted) {
+  std::filesystem::remove_all(cache_dir);
+  std::filesystem::create_directories(cache_dir);
+
+  try {
+    // pids say nothing about the stores of other hosts sharing the cache
+    auto dir = std::filesystem::path{cache_dir};
+    auto orphaned = dir / "key1.tmp.1.0";
+    auto recent = dir / "key2.tmp.1.0";
+    std::ofstream{orphaned} << "partial";
+    std::ofstream{recent} << "partial";
+    backdate(orphaned.string());
+
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           20, 'c');
+    backdate(file_signature::default_input_file);
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10,
+                             cache_options(1000));
+
+    EXPECT_FALSE(std::filesystem::exists(orphaned));
+    EXPECT_TRUE(std::filesystem::exists(recent));
+    EXPECT_EQ(1, cache_entries());
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+
+  std::filesystem::remove_all(cache_dir);
+}
+
+TEST(Cache, FailedStoreKeepsSignature) {
+  std::filesystem::remove_all(cache_dir);
+
+  try {
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           20, 'c');
+    backdate(file_signature::default_input_file);
+
+    // a directory in the way of the entry makes the rename fail
+    auto key = file_signature::signature_cache::key(
+        file_signature::stat_identity(file_signature::default_input_file), 10,
+        cache_options());
+    std::filesystem::create_directories(std::filesystem::path{cache_dir} /
+                                        (key + ".signature") / "in_the_way");
+
+    file_signature::stats st;
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10,
+                             cache_options(), &st);
+    EXPECT_EQ(1, st.cache_misses);
+    EXPECT_EQ(2, file_signature::read_file(file_signature::default_output_file)
+                     .size());
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+
+  std::filesystem::remove_all(cache_dir);
+}
@@ -0,0 +1,225 @@
+#include <file_signature/file_signature.h>
+#include <file_signature/file_signature_impl.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace file_signature {
+
+dedup_report dedup(const std::vector<std::string>& input_files,
+                   const std::vector<std::string>& signature_files,
+                   int block_size, std::uint64_t max_index_bytes) {
+  if (input_files.size() != signature_files.size()) {
+    throw error("dedup error: every input file needs a signature file");
+  }
+
+  dedup_index index{dedup_index::entries_for(max_index_bytes)};
+  dedup_report report{};
+
+  for (std::size_t i = 0; i < input_files.size(); i++) {
+    report.files.push_back({input_files[i], 0, 0, 0});
+
+    try {
+      writer_impl w{signature_files[i]};
+      dedup_writer dw{w, index, static_cast<int>(i), report.files.back()};
+      digest_set digests;
+      digests.xxh64 = true;
+      hash_calc_impl h{dw, digests};
+      reader r{input_files[i], block_size, h};
+
+      run_pipeline(r, h, w);
+    } catch (std::exception& e) {
+      std::throw_with_nested(error("dedup error: " + input_files[i]));
+    }
+
+    report.total_blocks += report.files.back().blocks;
+  }
+
+  report.exact = !index.overflowed();
+  report.distinct_blocks =
+      report.exact ? index.size() : index.distinct_estimate();
+  report.ratio = report.distinct_blocks > 0
+                     ? report.total_blocks / report.distinct_blocks
+                     : 1.0;
+
+  for (const auto& e : index.entries()) {
+    if (e.count > 1) {
+      report.groups.push_back({e.digest, static_cast<int>(e.first_file),
+                               e.first_block, e.count});
+    }
+  }
+
+  std::sort(report.groups.begin(), report.groups.end(),
+            [](const dedup_group& a, const dedup_group& b) {
+              if (a.count != b.count) {
+                return a.count > b.count;
+              }
+              if (a.first_file != b.first_file) {
+                return a.first_file < b.first_file;
+              }
+              return a.first_block < b.first_block;
+            });
+
+  return report;
+}
+
+void print_dedup_report(std::ostream& s, const dedup_report& report) {
+  s << "total blocks: " << report.total_blocks << '\n';
+  s << "distinct blocks: "
+    << static_cast<std::uint64_t>(report.distinct_blocks)
+    << (report.exact ? "" : " (estimate)") << '\n';
+  s << "dedup ratio: " << report.ratio << '\n';
+
+  // duplicates among the untracked blocks weren't seen
+  const char* partial = report.exact ? "" : " (partial)";
+
+  s << "duplicate groups: " << report.groups.size() << partial << '\n';
+  for (const auto& g : report.groups) {
+    s << "  " << g.digest << ' ' << report.files[g.first_file].input_file
+      << ':' << g.first_block << ' ' << g.count << '\n';
+  }
+
+  s << "files:\n";
+  for (const auto& f : report.files) {
+    s << "  " << f.input_file << " blocks=" << f.blocks
+      << " duplicates" << (report.exact ? "=" : ">=") << f.duplicate_blocks
+      << " untracked=" << f.untracked_blocks << '\n';
+  }
+}
+
+//
+// hll_sketch
+//
+
+hll_sketch::hll_sketch() : registers{} {}
+
+void hll_sketch::add(std::uint64_t digest) {
+  auto h = mix64(digest);
+  auto i = h >> (64 - precision);
+  auto rest = h << precision;
+
+  std::uint8_t rank = 1;
+  while (rank <= 64 - precision && (rest & (1ULL << 63)) == 0) {
+    rest <<= 1;
+    rank++;
+  }
+
+  registers[i] = std::max(registers[i], rank);
+}
+
+double hll_sketch::estimate() const {
+  const double m = registers.size();
+  const double alpha = 0.7213 / (1 + 1.079 / m);
+
+  double sum = 0;
+  int zeros = 0;
+  for (auto r : registers) {
+    sum += std::ldexp(1.0, -r);
+    if (r == 0) {
+      zeros++;
+    }
+  }
+
+  double e = alpha * m * m / sum;
+  if (e <= 2.5 * m && zeros > 0) {
+    e = m * std::log(m / zeros);
+  }
+
+  return e;
+}
+
+//
+// dedup_index
+//
+
+std::size_t dedup_index::entries_for(std::uint64_t max_bytes) {
+  return max_bytes / peak_bytes_per_entry;
+}
+
+dedup_index::dedup_index(std::size_t max_entries)
+    : max_entries{max_entries}, table(16), used{0}, overflow{false} {}
+
+dedup_index::result dedup_index::insert(std::uint64_t digest, int file,
+                                        std::uint64_t block) {
+  sketch.add(digest);
+
+  auto& e = table[find_slot(digest)];
+  if (e.count > 0) {
+    e.count++;
+    return result::duplicate;
+  }
+
+  if (used >= max_entries) {
+    overflow = true;
+    return result::untracked;
+  }
+
+  e = {digest, block, 1, static_cast<std::uint32_t>(file)};
+  used++;
+
+  if (used * 4 > table.size() * 3) {
+    grow();
+  }
+
+  return result::first;
+}
+
+std::size_t dedup_index::find_slot(std::uint64_t digest) const {
+  const auto mask = table.size() - 1;
+  auto i = mix64(digest) & mask;
+
+  while (table[i].count > 0 && table[i].digest != digest) {
+    i = (i + 1) & mask;
+  }
+
+  return i;
+}
+
+void dedup_index::grow() {
+  std::vector<entry> old(table.size() * 2);
+  old.swap(table);
+
+  for (const auto& e : old) {
+    if (e.count > 0) {
+      table[find_slot(e.digest)] = e;
+    }
+  }
+}
+
+//
+// dedup_writer
+//
+
+dedup_writer::dedup_writer(writer& next, dedup_index& index, int file,
+                           dedup_file_stats& stats)
+    : next{next}, index{index}, file{file}, stats{stats} {}
+
+void dedup_writer::on_calc_block_hash(int hash) {
+  next.on_calc_block_hash(hash);
+}
+
+void dedup_writer::on_calc_block_digests(const block_digests& d) {
+  switch (index.insert(d.xxh64, file, stats.blocks++)) {
+    case dedup_index::result::duplicate:
+      stats.duplicate_blocks++;
+      break;
+    case dedup_index::result::untracked:
+      stats.untracked_blocks++;
+      break;
+    case dedup_index::result::first:
+      break;
+  }
+
+  next.on_calc_block_hash(d.crc32);
+}
+
+void dedup_writer::on_finishing_hash_calc() { next.on_finishing_hash_calc(); }
+
+void dedup_writer::on_pipeline_failure() { next.on_pipeline_failure(); }
+
+}  // namespace file_signature
@@ -0,0 +1,150 @@
+#include <file_signature/file_signature.h>
+#include <file_signature/file_signature.test.h>
+#include <file_signature/file_signature_impl.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+TEST(DedupIndex, FirstAndDuplicate) {
+  file_signature::dedup_index index{100};
+
+  EXPECT_EQ(file_signature::dedup_index::result::first, index.insert(1, 0, 0));
+  EXPECT_EQ(file_signature::dedup_index::result::first, index.insert(2, 0, 1));
+  EXPECT_EQ(file_signature::dedup_index::result::duplicate,
+            index.insert(1, 1, 7));
+  EXPECT_EQ(2, index.size());
+  EXPECT_FALSE(index.overflowed());
+
+  for (const auto& e : index.entries()) {
+    if (e.count > 0 && e.digest == 1) {
+      EXPECT_EQ(0, e.first_file);
+      EXPECT_EQ(0, e.first_block);
+      EXPECT_EQ(2, e.count);
+    }
+  }
+}
+
+TEST(DedupIndex, Grow) {
+  file_signature::dedup_index index{10000};
+
+  for (std::uint32_t i = 0; i < 10000; i++) {
+    ASSERT_EQ(file_signature::dedup_index::result::first,
+              index.insert(i, 0, i));
+  }
+  for (std::uint32_t i = 0; i < 10000; i++) {
+    ASSERT_EQ(file_signature::dedup_index::result::duplicate,
+              index.insert(i, 0, i));
+  }
+  EXPECT_EQ(10000, index.size());
+}
+
+TEST(DedupIndex, OverflowFallsBackToSketch) {
+  file_signature::dedup_index index{100};
+
+  for (std::uint32_t i = 0; i < 100000; i++) {
+    index.insert(i, 0, i);
+  }
+
+  EXPECT_TRUE(index.overflowed());
+  EXPECT_EQ(100, index.size());
+  EXPECT_NEAR(100000, index.distinct_estimate(), 100000 * 0.05);
+}
+
+TEST(DedupIndex, StaysWithinMemory) {
+  const std::uint64_t max_bytes = 1 << 20;
+  file_signature::dedup_index index{
+      file_signature::dedup_index::entries_for(max_bytes)};
+
+  for (std::uint32_t i = 0; i < 100000; i++) {
+    index.insert(i, 0, i);
+  }
+
+  EXPECT_TRUE(index.overflowed());
+  // the old table is held while the doubled one is filled
+  auto table = index.entries().size() * sizeof(index.entries()[0]);
+  EXPECT_LE(table + table / 2, max_bytes);
+}
+
+TEST(Dedup, TwoFiles) {
+  try {
+    file_signature::create_file_for_reader("dedup1.txt", 30, 'c');
+    file_signature::create_file_for_reader("dedup2.txt", 25, 'c');
+
+    auto report = file_signature::dedup(
+        {"dedup1.txt", "dedup2.txt"}, {"dedup1.signature", "dedup2.signature"},
+        10, 1 << 20);
+
+    EXPECT_EQ(6, report.total_blocks);
+    EXPECT_TRUE(report.exact);
+    EXPECT_EQ(2, report.distinct_blocks);
+    EXPECT_EQ(3, report.ratio);
+
+    ASSERT_EQ(1, report.groups.size());
+    file_signature::xxh64 block;
+    block.update(std::string(10, 'c').data(), 10);
+    EXPECT_EQ(block.digest(), report.groups[0].digest);
+    EXPECT_EQ(0, report.groups[0].first_file);
+    EXPECT_EQ(0, report.groups[0].first_block);
+    EXPECT_EQ(5, report.groups[0].count);
+
+    ASSERT_EQ(2, report.files.size());
+    EXPECT_EQ(3, report.files[0].blocks);
+    EXPECT_EQ(2, report.files[0].duplicate_blocks);
+    EXPECT_EQ(3, report.files[1].blocks);
+    EXPECT_EQ(2, report.files[1].duplicate_blocks);
+
+    auto lines = file_signature::read_file("dedup2.signature");
+    ASSERT_EQ(3, lines.size());
+    EXPECT_EQ(lines[0], lines[1]);
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+
+  file_signature::delete_file_for_reader("dedup1.txt");
+  file_signature::delete_file_for_reader("dedup2.txt");
+  file_signature::delete_file_for_reader("dedup1.signature");
+  file_signature::delete_file_for_reader("dedup2.signature");
+}
+
+TEST(Dedup, OverflowedReportIsPartial) {
+  try {
+    file_signature::create_file_for_reader("dedup1.txt", 30, 'c');
+    file_signature::create_file_for_reader("dedup2.txt", 30, 'd');
+
+    auto report = file_signature::dedup(
+        {"dedup1.txt", "dedup2.txt"}, {"dedup1.signature", "dedup2.signature"},
+        10, file_signature::dedup_index::peak_bytes_per_entry);
+    EXPECT_FALSE(report.exact);
+    EXPECT_EQ(2, report.files[0].duplicate_blocks);
+    // the 'd' blocks weren't indexed, their duplicates aren't known
+    EXPECT_EQ(0, report.files[1].duplicate_blocks);
+    EXPECT_EQ(3, report.files[1].untracked_blocks);
+
+    std::ostringstream s;
+    file_signature::print_dedup_report(s, report);
+    EXPECT_NE(std::string::npos, s.str().find("duplicate groups: 1 (partial)"));
+    EXPECT_NE(std::string::npos, s.str().find("duplicates>=0"));
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+
+  file_signature::delete_file_for_reader("dedup1.txt");
+  file_signature::delete_file_for_reader("dedup2.txt");
+  file_signature::delete_file_for_reader("dedup1.signature");
+  file_signature::delete_file_for_reader("dedup2.signature");
+}
+
+TEST(Dedup, NotExistingFile) {
+  try {
+    file_signature::delete_file_for_reader(file_signature::default_input_file);
+
+    file_signature::dedup({file_signature::default_input_file},
+                          {file_signature::default_output_file}, 10,
+                          1 << 20);
+    FAIL() << "expected to throw an exception";
+  } catch (std::exception& e) {
+    SUCCEED();
+  }
+}
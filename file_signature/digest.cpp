@@ -0,0 +1,298 @@
+#include <file_signature/file_signature.h>
+#include <file_signature/file_signature_impl.h>
+
+#include <algorithm>
+#include <boost/crc.hpp>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace file_signature {
+
+namespace {
+
+// small enough to stay in L1 while every digest reads it
+constexpr std::size_t chunk_size = 16 << 10;
+
+constexpr std::uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+std::uint32_t rotr32(std::uint32_t x, int n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+constexpr std::uint64_t prime64_1 = 11400714785074694791ULL;
+constexpr std::uint64_t prime64_2 = 14029467366897019727ULL;
+constexpr std::uint64_t prime64_3 = 1609587929392839161ULL;
+constexpr std::uint64_t prime64_4 = 9650029242287828579ULL;
+constexpr std::uint64_t prime64_5 = 2870177450012600261ULL;
+
+std::uint64_t rotl64(std::uint64_t x, int n) {
+  return (x << n) | (x >> (64 - n));
+}
+
+// xxh64 is specified over little-endian words
+std::uint64_t read64(const unsigned char* p) {
+  std::uint64_t v = 0;
+  for (int i = 7; i >= 0; i--) {
+    v = (v << 8) | p[i];
+  }
+  return v;
+}
+
+std::uint32_t read32(const unsigned char* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | (std::uint32_t(p[3]) << 24);
+}
+
+std::uint64_t xxh64_round(std::uint64_t acc, std::uint64_t input) {
+  acc += input * prime64_2;
+  acc = rotl64(acc, 31);
+  return acc * prime64_1;
+}
+
+std::uint64_t xxh64_merge_round(std::uint64_t acc, std::uint64_t val) {
+  acc ^= xxh64_round(0, val);
+  return acc * prime64_1 + prime64_4;
+}
+
+}  // namespace
+
+block_digests calc_block_digests(const char* data, std::size_t size,
+                                 const digest_set& digests,
+                                 sha256* file_sha256) {
+  block_hasher h{digests};
+
+  for (std::size_t offset = 0; offset < size; offset += chunk_size) {
+    auto chunk = data + offset;
+    auto n = std::min(chunk_size, size - offset);
+
+    h.update(chunk, n);
+    if (file_sha256) {
+      file_sha256->update(chunk, n);
+    }
+  }
+
+  return h.digests();
+}
+
+//
+// block_hasher
+//
+
+block_hasher::block_hasher(const digest_set& digests) : enabled{digests} {}
+
+void block_hasher::update(const char* data, std::size_t size) {
+  for (std::size_t offset = 0; offset < size; offset += chunk_size) {
+    auto chunk = data + offset;
+    auto n = std::min(chunk_size, size - offset);
+
+    crc32.process_bytes(chunk, n);
+    if (enabled.crc32c) {
+      crc32c.process_bytes(chunk, n);
+    }
+    if (enabled.xxh64) {
+      x.update(chunk, n);
+    }
+  }
+}
+
+block_digests block_hasher::digests() const {
+  return {static_cast<int>(crc32.checksum()),
+          enabled.crc32c ? crc32c.checksum() : 0,
+          enabled.xxh64 ? x.digest() : 0};
+}
+
+//
+// sha256
+//
+
+sha256::sha256()
+    : state{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f,
+            0x9b05688c, 0x1f83d9ab, 0x5be0cd19},
+      buffer{},
+      buffered{0},
+      length{0} {}
+
+void sha256::update(const char* data, std::size_t size) {
+  auto p = reinterpret_cast<const unsigned char*>(data);
+  length += size;
+
+  if (buffered > 0) {
+    auto n = std::min(size, buffer.size() - buffered);
+    std::memcpy(buffer.data() + buffered, p, n);
+    buffered += n;
+    p += n;
+    size -= n;
+
+    if (buffered < buffer.size()) {
+      return;
+    }
+    transform(buffer.data());
+    buffered = 0;
+  }
+
+  for (; size >= buffer.size(); p += buffer.size(), size -= buffer.size()) {
+    transform(p);
+  }
+
+  std::memcpy(buffer.data(), p, size);
+  buffered = size;
+}
+
+std::string sha256::hex_digest() {
+  auto bits = length * 8;
+
+  unsigned char padding[72] = {0x80};
+  auto pad = (buffered < 56 ? 56 : 120) - buffered;
+  for (int i = 0; i < 8; i++) {
+    padding[pad + i] = static_cast<unsigned char>(bits >> (56 - 8 * i));
+  }
+  update(reinterpret_cast<const char*>(padding), pad + 8);
+
+  static const char hex[] = "0123456789abcdef";
+  std::string result;
+  for (auto word : state) {
+    for (int shift = 28; shift >= 0; shift -= 4) {
+      result += hex[(word >> shift) & 0xf];
+    }
+  }
+  return result;
+}
+
+void sha256::transform(const unsigned char* block) {
+  std::uint32_t w[64];
+  for (int i = 0; i < 16; i++) {
+    w[i] = (std::uint32_t(block[4 * i]) << 24) | (block[4 * i + 1] << 16) |
+           (block[4 * i + 2] << 8) | block[4 * i + 3];
+  }
+  for (int i = 16; i < 64; i++) {
+    auto s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    auto s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  auto a = state[0], b = state[1], c = state[2], d = state[3];
+  auto e = state[4], f = state[5], g = state[6], h = state[7];
+
+  for (int i = 0; i < 64; i++) {
+    auto s1 = rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25);
+    auto ch = (e & f) ^ (~e & g);
+    auto t1 = h + s1 + ch + sha256_k[i] + w[i];
+    auto s0 = rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22);
+    auto maj = (a & b) ^ (a & c) ^ (b & c);
+    auto t2 = s0 + maj;
+
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+  state[5] += f;
+  state[6] += g;
+  state[7] += h;
+}
+
+//
+// xxh64
+//
+
+xxh64::xxh64(std::uint64_t seed)
+    : seed{seed},
+      acc{seed + prime64_1 + prime64_2, seed + prime64_2, seed,
+          seed - prime64_1},
+      buffer{},
+      buffered{0},
+      length{0} {}
+
+void xxh64::update(const char* data, std::size_t size) {
+  auto p = reinterpret_cast<const unsigned char*>(data);
+  length += size;
+
+  auto stripe = [this](const unsigned char* s) {
+    for (int i = 0; i < 4; i++) {
+      acc[i] = xxh64_round(acc[i], read64(s + 8 * i));
+    }
+  };
+
+  if (buffered > 0) {
+    auto n = std::min(size, buffer.size() - buffered);
+    std::memcpy(buffer.data() + buffered, p, n);
+    buffered += n;
+    p += n;
+    size -= n;
+
+    if (buffered < buffer.size()) {
+      return;
+    }
+    stripe(buffer.data());
+    buffered = 0;
+  }
+
+  for (; size >= buffer.size(); p += buffer.size(), size -= buffer.size()) {
+    stripe(p);
+  }
+
+  std::memcpy(buffer.data(), p, size);
+  buffered = size;
+}
+
+std::uint64_t xxh64::digest() const {
+  std::uint64_t h;
+
+  if (length >= buffer.size()) {
+    h = rotl64(acc[0], 1) + rotl64(acc[1], 7) + rotl64(acc[2], 12) +
+        rotl64(acc[3], 18);
+    for (auto a : acc) {
+      h = xxh64_merge_round(h, a);
+    }
+  } else {
+    h = seed + prime64_5;
+  }
+
+  h += length;
+
+  auto p = buffer.data();
+  auto end = p + buffered;
+  for (; p + 8 <= end; p += 8) {
+    h ^= xxh64_round(0, read64(p));
+    h = rotl64(h, 27) * prime64_1 + prime64_4;
+  }
+  if (p + 4 <= end) {
+    h ^= read32(p) * prime64_1;
+    h = rotl64(h, 23) * prime64_2 + prime64_3;
+    p += 4;
+  }
+  for (; p < end; p++) {
+    h ^= *p * prime64_5;
+    h = rotl64(h, 11) * prime64_1;
+  }
+
+  h ^= h >> 33;
+  h *= prime64_2;
+  h ^= h >> 29;
+  h *= prime64_3;
+  h ^= h >> 32;
+  return h;
+}
+
+}  // namespace file_signature
@@ -0,0 +1,108 @@
+#include <file_signature/file_signature.h>
+#include <file_signature/file_signature.test.h>
+#include <file_signature/file_signature_impl.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string sha256_of(const std::string& s) {
+  file_signature::sha256 h;
+  h.update(s.data(), s.size());
+  return h.hex_digest();
+}
+
+std::uint64_t xxh64_of(const std::string& s) {
+  file_signature::xxh64 h;
+  h.update(s.data(), s.size());
+  return h.digest();
+}
+
+}  // namespace
+
+TEST(Digest, Sha256) {
+  EXPECT_EQ("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+            sha256_of(""));
+  EXPECT_EQ("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+            sha256_of("abc"));
+  EXPECT_EQ("cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0",
+            sha256_of(std::string(1000000, 'a')));
+}
+
+TEST(Digest, Xxh64) {
+  EXPECT_EQ(0xEF46DB3751D8E999ULL, xxh64_of(""));
+  EXPECT_EQ(0x44BC2CF5AD770999ULL, xxh64_of("abc"));
+  EXPECT_EQ(0xFBCEA83C8A378BF1ULL,
+            xxh64_of("Nobody inspects the spammish repetition"));
+}
+
+TEST(Digest, StreamingMatchesOneShot) {
+  std::string data;
+  for (int i = 0; i < 1000; i++) {
+    data += static_cast<char>(i * 7);
+  }
+
+  file_signature::sha256 s;
+  file_signature::xxh64 x;
+  for (std::size_t i = 0; i < data.size(); i += 13) {
+    auto part = data.substr(i, 13);
+    s.update(part.data(), part.size());
+    x.update(part.data(), part.size());
+  }
+
+  EXPECT_EQ(sha256_of(data), s.hex_digest());
+  EXPECT_EQ(xxh64_of(data), x.digest());
+}
+
+TEST(Digest, BlockDigests) {
+  std::string data = "123456789";
+  file_signature::digest_set digests;
+  digests.crc32c = true;
+  digests.xxh64 = true;
+
+  file_signature::sha256 file_sha256;
+  auto d = file_signature::calc_block_digests(data.data(), data.size(),
+                                              digests, &file_sha256);
+
+  EXPECT_EQ(static_cast<int>(0xCBF43926), d.crc32);
+  EXPECT_EQ(0xE3069283, d.crc32c);
+  EXPECT_EQ(xxh64_of(data), d.xxh64);
+  EXPECT_EQ(sha256_of(data), file_sha256.hex_digest());
+}
+
+TEST(Digest, GenerateWithAllDigests) {
+  try {
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           25, 'c');
+
+    file_signature::options opts;
+    opts.digests.crc32c = true;
+    opts.digests.xxh64 = true;
+    opts.digests.sha256 = true;
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10, opts);
+
+    auto lines = file_signature::read_file(file_signature::default_output_file);
+    ASSERT_EQ(4, lines.size());
+
+    file_signature::signature_header h;
+    ASSERT_TRUE(file_signature::parse_header(lines[0], h));
+    EXPECT_EQ("crc32,crc32c,xxh64", h["digests"]);
+    EXPECT_EQ(sha256_of(std::string(25, 'c')), h["sha256"]);
+
+    auto block = std::string(10, 'c');
+    EXPECT_EQ(lines[1], lines[2]);
+    EXPECT_EQ(std::to_string(file_signature::block_hash(block.data(), 10)) +
+                  " " +
+                  std::to_string(file_signature::calc_block_digests(
+                                     block.data(), 10, opts.digests, nullptr)
+                                     .crc32c) +
+                  " " + std::to_string(xxh64_of(block)),
+              lines[1]);
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+}
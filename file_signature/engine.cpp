@@ -0,0 +1,149 @@
+#include <file_signature/file_signature.h>
+#include <file_signature/file_signature_impl.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace file_signature {
+
+//
+// job
+//
+
+job::job(std::shared_ptr<async_job> impl, std::future<void> result)
+    : impl{std::move(impl)}, result{std::move(result)} {}
+
+void job::get() { result.get(); }
+
+void job::wait() const { result.wait(); }
+
+void job::cancel() { impl->cancel(); }
+
+//
+// engine
+//
+
+engine::engine(engine_config config)
+    : scheduler{std::make_unique<job_scheduler>(config.memory_budget,
+                                                config.max_reads)},
+      pool{config.threads} {}
+
+engine::~engine() {
+  std::unique_lock lk{mt};
+  for (auto& j : jobs) {
+    if (auto p = j.lock()) {
+      p->cancel();
+    }
+  }
+}
+
+job engine::submit(std::string input_file, std::string signature_file,
+                   int block_size, const options& opts) {
+  if (opts.numa_node >= 0) {
+    throw error("engine jobs can't be bound to a numa node");
+  }
+  if (opts.append) {
+    throw error("engine jobs can't append to a signature");
+  }
+
+  auto impl =
+      std::make_shared<async_job>(input_file, signature_file, block_size, opts,
+                                  pool.get_executor(), scheduler.get());
+
+  std::unique_lock lk{mt};
+  jobs.erase(std::remove_if(jobs.begin(), jobs.end(),
+                            [](const auto& j) { return j.expired(); }),
+             jobs.end());
+  jobs.push_back(impl);
+  lk.unlock();
+
+  auto result = impl->start();
+  return {std::move(impl), std::move(result)};
+}
+
+//
+// job_scheduler
+//
+
+job_scheduler::job_scheduler(std::uint64_t memory_budget, unsigned max_reads)
+    : memory_budget{memory_budget},
+      max_reads{std::max(max_reads, 1u)},
+      memory_used{0},
+      reads{0},
+      buffered_bytes{0} {}
+
+void job_scheduler::request_read(std::uint64_t bytes,
+                                 std::function<void()> admitted) {
+  std::unique_lock lk{mt};
+  waiting.emplace_back(bytes, std::move(admitted));
+  admit(lk);
+}
+
+void job_scheduler::finish_read() {
+  std::unique_lock lk{mt};
+  reads--;
+  admit(lk);
+}
+
+void job_scheduler::release(std::uint64_t bytes) {
+  std::unique_lock lk{mt};
+  memory_used -= bytes;
+  admit(lk);
+}
+
+void job_scheduler::admit(std::unique_lock<std::mutex>& lk) {
+  std::vector<std::function<void()>> admitted;
+
+  // strictly in order, so a job needing a large block isn't starved by the
+  // jobs behind it; a block larger than the budget gets it all to itself
+  while (!waiting.empty() && reads < max_reads &&
+         (memory_used + waiting.front().first <= memory_budget ||
+          memory_used == 0)) {
+    memory_used += waiting.front().first;
+    reads++;
+    admitted.push_back(std::move(waiting.front().second));
+    waiting.pop_front();
+  }
+  lk.unlock();
+
+  for (auto& f : admitted) {
+    f();
+  }
+}
+
+file_block job_scheduler::acquire_buffer(std::size_t size) {
+  std::unique_lock lk{mt};
+  if (buffers.empty()) {
+    lk.unlock();
+    return file_block(size, 0);
+  }
+
+  auto b = std::move(buffers.back());
+  buffers.pop_back();
+  buffered_bytes -= b.capacity();
+  lk.unlock();
+
+  b.resize(size);
+  return b;
+}
+
+void job_scheduler::recycle_buffer(file_block b) {
+  std::unique_lock lk{mt};
+  // the pooled buffers count against the budget with the blocks in use
+  if (b.capacity() == 0 ||
+      memory_used + buffered_bytes + b.capacity() > memory_budget) {
+    return;
+  }
+
+  buffered_bytes += b.capacity();
+  buffers.push_back(std::move(b));
+}
+
+}  // namespace file_signature
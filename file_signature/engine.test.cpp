@@ -0,0 +1,259 @@
+#include <file_signature/file_signature.h>
+#include <file_signature/file_signature.test.h>
+#include <file_signature/file_signature_impl.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+TEST(Engine, SameAsGenerate) {
+  try {
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           1005, 'c');
+    file_signature::options opts;
+    opts.digests.crc32c = true;
+    opts.digests.xxh64 = true;
+    opts.digests.sha256 = true;
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10, opts);
+
+    file_signature::engine e{{2, 100, 1}};
+    e.submit(file_signature::default_input_file, "engine.signature", 10, opts)
+        .get();
+
+    EXPECT_EQ(file_signature::read_file(file_signature::default_output_file),
+              file_signature::read_file("engine.signature"));
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+
+  file_signature::delete_file_for_reader("engine.signature");
+}
+
+TEST(Engine, Shard) {
+  try {
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           95, 'c');
+    file_signature::options opts;
+    opts.shard = true;
+    opts.offset = 30;
+    opts.length = 40;
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10, opts);
+
+    file_signature::engine e{{2}};
+    e.submit(file_signature::default_input_file, "engine.signature", 10, opts)
+        .get();
+
+    auto lines = file_signature::read_file("engine.signature");
+    EXPECT_EQ(5, lines.size());
+    EXPECT_EQ(file_signature::read_file(file_signature::default_output_file),
+              lines);
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+
+  file_signature::delete_file_for_reader("engine.signature");
+}
+
+TEST(Engine, ManyJobsWithinBudget) {
+  try {
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           95, 'c');
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10);
+    auto expected =
+        file_signature::read_file(file_signature::default_output_file);
+
+    // room for a single block, the jobs take turns
+    file_signature::engine e{{4, 10, 1}};
+    std::vector<file_signature::job> jobs;
+    for (int i = 0; i < 20; i++) {
+      jobs.push_back(e.submit(file_signature::default_input_file,
+                              "engine" + std::to_string(i) + ".signature",
+                              10));
+    }
+
+    for (int i = 0; i < 20; i++) {
+      jobs[i].get();
+      auto name = "engine" + std::to_string(i) + ".signature";
+      EXPECT_EQ(expected, file_signature::read_file(name));
+      file_signature::delete_file_for_reader(name);
+    }
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+}
+
+TEST(Engine, Cancel) {
+  file_signature::create_file_for_reader(file_signature::default_input_file,
+                                         1 << 20, 'c');
+  file_signature::engine e{{1}};
+
+  auto j = e.submit(file_signature::default_input_file,
+                    file_signature::default_output_file, 16);
+  j.cancel();
+
+  try {
+    j.get();
+    FAIL() << "expected to throw an exception";
+  } catch (std::exception& e) {
+    SUCCEED();
+  }
+}
+
+TEST(Engine, CancelFinishedJob) {
+  try {
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           20, 'c');
+    file_signature::engine e{{1}};
+
+    auto j = e.submit(file_signature::default_input_file,
+                      file_signature::default_output_file, 10);
+    j.wait();
+    j.cancel();
+    j.get();
+
+    EXPECT_EQ(2, file_signature::read_file(file_signature::default_output_file)
+                     .size());
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+}
+
+TEST(Engine, DestroyedWithRunningJob) {
+  file_signature::create_file_for_reader(file_signature::default_input_file,
+                                         1 << 20, 'c');
+  file_signature::job j = [] {
+    file_signature::engine e{{1}};
+    return e.submit(file_signature::default_input_file,
+                    file_signature::default_output_file, 16);
+  }();
+
+  try {
+    j.get();
+    FAIL() << "expected to throw an exception";
+  } catch (std::exception& e) {
+    SUCCEED();
+  }
+}
+
+TEST(Engine, NotExistingFile) {
+  file_signature::delete_file_for_reader(file_signature::default_input_file);
+  file_signature::engine e{{1}};
+
+  auto j = e.submit(file_signature::default_input_file,
+                    file_signature::default_output_file, 10);
+
+  try {
+    j.get();
+    FAIL() << "expected to throw an exception";
+  } catch (std::exception& e) {
+    SUCCEED();
+  }
+}
+
+TEST(Engine, NumaNodeIsRejected) {
+  file_signature::engine e{{1}};
+  file_signature::options opts;
+  opts.numa_node = 0;
+
+  try {
+    e.submit(file_signature::default_input_file,
+             file_signature::default_output_file, 10, opts);
+    FAIL() << "expected to throw an exception";
+  } catch (std::exception& e) {
+    SUCCEED();
+  }
+}
+
+TEST(Engine, AppendIsRejected) {
+  file_signature::engine e{{1}};
+  file_signature::options opts;
+  opts.append = true;
+
+  try {
+    e.submit(file_signature::default_input_file,
+             file_signature::default_output_file, 10, opts);
+    FAIL() << "expected to throw an exception";
+  } catch (std::exception& e) {
+    SUCCEED();
+  }
+}
+
+TEST(JobScheduler, AdmitsInOrderWithinBudget) {
+  file_signature::job_scheduler s{20, 4};
+  std::vector<int> admitted;
+
+  s.request_read(10, [&admitted]() { admitted.push_back(1); });
+  s.request_read(10, [&admitted]() { admitted.push_back(2); });
+  s.request_read(10, [&admitted]() { admitted.push_back(3); });
+  s.request_read(5, [&admitted]() { admitted.push_back(4); });
+  EXPECT_EQ((std::vector<int>{1, 2}), admitted);
+
+  // the read is done but its block is still held
+  s.finish_read();
+  EXPECT_EQ((std::vector<int>{1, 2}), admitted);
+
+  s.release(10);
+  EXPECT_EQ((std::vector<int>{1, 2, 3}), admitted);
+
+  s.finish_read();
+  s.release(10);
+  EXPECT_EQ((std::vector<int>{1, 2, 3, 4}), admitted);
+}
+
+TEST(JobScheduler, LimitsReads) {
+  file_signature::job_scheduler s{100, 1};
+  int admitted = 0;
+
+  s.request_read(10, [&admitted]() { admitted++; });
+  s.request_read(10, [&admitted]() { admitted++; });
+  EXPECT_EQ(1, admitted);
+
+  s.finish_read();
+  EXPECT_EQ(2, admitted);
+}
+
+TEST(JobScheduler, BlockLargerThanBudget) {
+  file_signature::job_scheduler s{10, 4};
+  int admitted = 0;
+
+  s.request_read(30, [&admitted]() { admitted++; });
+  s.request_read(5, [&admitted]() { admitted++; });
+  EXPECT_EQ(1, admitted);
+
+  s.finish_read();
+  s.release(30);
+  EXPECT_EQ(2, admitted);
+}
+
+TEST(JobScheduler, ReusesBuffers) {
+  file_signature::job_scheduler s{100, 1};
+
+  auto b = s.acquire_buffer(10);
+  ASSERT_EQ(10, b.size());
+  auto data = b.data();
+  s.recycle_buffer(std::move(b));
+
+  auto again = s.acquire_buffer(5);
+  EXPECT_EQ(5, again.size());
+  EXPECT_EQ(data, again.data());
+}
+
+TEST(JobScheduler, PoolFitsInBudget) {
+  file_signature::job_scheduler s{100, 2};
+
+  s.request_read(60, []() {});
+  auto held = s.acquire_buffer(60);
+
+  // 60 bytes are in use, a pooled 50 would exceed the budget
+  s.recycle_buffer(file_signature::file_block(50, 0));
+  EXPECT_EQ(1, s.acquire_buffer(1).capacity());
+
+  s.finish_read();
+  s.release(60);
+  s.recycle_buffer(std::move(held));
+  s.recycle_buffer(file_signature::file_block(50, 0));
+  EXPECT_EQ(60, s.acquire_buffer(1).capacity());
+}
@@ -1,11 +1,17 @@
 #include <file_signature/file_signature.h>
 #include <file_signature/file_signature_impl.h>
 
+#include <algorithm>
+#include <atomic>
 #include <boost/crc.hpp>
+#include <chrono>
+#include <filesystem>
 #include <fstream>
 #include <future>
 #include <ios>
 #include <memory>
+#include <ostream>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 #include <utility>
@@ -19,44 +25,157 @@ void generate(std::string input_file, std::string signature_file,
   g.run();
 }
 
+void generate(std::string input_file, std::string signature_file,
+              int block_size, const options& opts, stats* st) {
+  generator g{input_file, signature_file, block_size, opts, st};
+  g.run();
+}
+
+void print_stats(std::ostream& s, const stats& st) {
+  s << "blocks: " << st.blocks << '\n';
+  s << "bytes: " << st.bytes << '\n';
+  s << "seconds: " << st.seconds << '\n';
+  s << "throughput: "
+    << (st.seconds > 0 ? st.bytes / st.seconds / (1 << 20) : 0) << " MiB/s\n";
+  s << "numa node: " << st.numa_node << '\n';
+  s << "cache hits: " << st.cache_hits << '\n';
+  s << "cache misses: " << st.cache_misses << '\n';
+  s << "numa topology:\n";
+  for (const auto& n : st.topology) {
+    s << "  node " << n.node << ": cpus";
+    for (auto c : n.cpus) {
+      s << ' ' << c;
+    }
+    s << '\n';
+  }
+}
+
 //
 // generator
 //
 
 generator::generator(std::string input_file, std::string signature_file,
-                     int block_size)
+                     int block_size, options opts, stats* st)
     : input_file{input_file},
       signature_file{signature_file},
-      block_size{block_size} {}
+      block_size{block_size},
+      opts{opts},
+      st{st} {}
 
 void generator::run() {
   try {
-    writer_impl w{signature_file};
-    hash_calc_impl h{w};
-    reader r{input_file, block_size, h};
+    if (opts.append) {
+      append();
+      return;
+    }
 
-    auto reader_result = std::async(std::launch::async, [&]() { r.run(); });
-    auto hash_calc_result = std::async(std::launch::async, [&]() { h.run(); });
-    auto writer_result = std::async(std::launch::async, [&]() { w.run(); });
+    if (opts.cache_dir.empty()) {
+      sign();
+      return;
+    }
 
-    reader_result.wait();
-    hash_calc_result.wait();
-    writer_result.wait();
+    cached_input cache{input_file, block_size, opts};
+    if (cache.lookup(signature_file)) {
+      if (st) {
+        st->cache_hits++;
+      }
+      return;
+    }
 
-    reader_result.get();
-    hash_calc_result.get();
-    writer_result.get();
+    if (st) {
+      st->cache_misses++;
+    }
+
+    sign();
+    cache.store(signature_file);
   } catch (std::exception& e) {
     std::throw_with_nested(error("generate error: " + input_file));
   }
 }
 
+void generator::sign() {
+  signature_header header;
+  if (opts.shard) {
+    header = shard_header(input_file, block_size, opts);
+  }
+
+  sign_range(std::move(header), opts.offset, opts.length);
+}
+
+void generator::sign_range(signature_header header, std::uint64_t offset,
+                           std::uint64_t length, std::uint64_t tail_offset) {
+  auto started = std::chrono::steady_clock::now();
+
+  writer_impl w{signature_file, opts.digests, std::move(header)};
+  if (tail_offset > 0) {
+    w.resume_at(tail_offset);
+  }
+  hash_calc_impl h{w, opts.digests};
+  reader r{input_file, block_size, h, offset, length};
+
+  auto numa_node = run_pipeline(r, h, w, opts.numa_node);
+
+  if (st) {
+    st->blocks += r.blocks_read();
+    st->bytes += r.bytes_read();
+    st->seconds += std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - started)
+                       .count();
+    st->numa_node = numa_node;
+    st->topology = numa_topology();
+  }
+}
+
+int run_pipeline(reader& r, hash_calc_impl& h, writer_impl& w,
+                 int numa_node) {
+  // the reader and the hash calc share the node so that blocks are hashed on
+  // the node whose memory they were read into
+  std::vector<int> cpus;
+  if (numa_node >= 0) {
+    cpus = numa_node_cpus(numa_node);
+  }
+
+  std::atomic<bool> bound{!cpus.empty()};
+  auto on_node = [&cpus, &bound](auto f) {
+    return [&cpus, &bound, f]() {
+      if (!cpus.empty() && !bind_to_cpus(cpus)) {
+        bound = false;
+      }
+      f();
+    };
+  };
+
+  auto reader_result =
+      std::async(std::launch::async, on_node([&]() { r.run(); }));
+  auto hash_calc_result =
+      std::async(std::launch::async, on_node([&]() { h.run(); }));
+  auto writer_result =
+      std::async(std::launch::async, on_node([&]() { w.run(); }));
+
+  reader_result.wait();
+  hash_calc_result.wait();
+  writer_result.wait();
+
+  reader_result.get();
+  hash_calc_result.get();
+  writer_result.get();
+
+  return bound ? numa_node : -1;
+}
+
 //
 // reader
 //
 
-reader::reader(const std::string& input_file, int block_size, hash_calc& calc)
-    : input_file{input_file}, block_size{block_size}, calc{calc} {}
+reader::reader(const std::string& input_file, int block_size, hash_calc& calc,
+               std::uint64_t offset, std::uint64_t length)
+    : input_file{input_file},
+      block_size{block_size},
+      calc{calc},
+      offset{offset},
+      length{length},
+      blocks{0},
+      bytes{0} {}
 
 void reader::run() {
   try {
@@ -72,8 +191,14 @@ void reader::run() {
     try {
       s.exceptions(std::ifstream::badbit);
 
-      while (s) {
-        std::vector<char> buffer(block_size, 0);
+      if (offset > 0) {
+        s.seekg(offset);
+      }
+
+      auto remaining = length > 0 ? length : ~std::uint64_t{0};
+      while (s && remaining > 0) {
+        std::vector<char> buffer(
+            std::min<std::uint64_t>(block_size, remaining), 0);
         s.read(&buffer[0], buffer.size());
 
         if (s.eof()) {
@@ -81,6 +206,9 @@ void reader::run() {
         }
 
         if (!buffer.empty()) {
+          blocks++;
+          bytes += buffer.size();
+          remaining -= buffer.size();
           calc.on_read_block(std::move(buffer));
         }
       }
@@ -100,14 +228,21 @@ void reader::run() {
 // block_hash_calc_impl
 //
 
-hash_calc_impl::hash_calc_impl(writer& w)
+constexpr std::size_t hash_calc_impl::max_queued_blocks;
+
+hash_calc_impl::hash_calc_impl(writer& w, digest_set digests)
     : writer_{w},
+      digests{digests},
       reader_finished{false},
       failed{false},
       pipeline_failed{false} {}
 
 void hash_calc_impl::on_read_block(file_block b) {
   std::unique_lock lk{mt};
+  space_cv.wait(lk, [this]() {
+    return blocks.size() < max_queued_blocks || failed || pipeline_failed;
+  });
+
   if (failed || pipeline_failed) {
     return;
   }
@@ -122,6 +257,7 @@ void hash_calc_impl::on_pipeline_failure() {
   pipeline_failed = true;
   lk.unlock();
   cv.notify_one();
+  space_cv.notify_one();
 
   writer_.on_pipeline_failure();
 }
@@ -157,16 +293,22 @@ void hash_calc_impl::run() {
       blocks.pop();
 
       lk.unlock();
+      space_cv.notify_one();
+
+      auto sha = digests.sha256 ? &file_sha256 : nullptr;
+      writer_.on_calc_block_digests(
+          calc_block_digests(b.data(), b.size(), digests, sha));
+    }
 
-      boost::crc_32_type result;
-      result.process_bytes(b.data(), b.size());
-      writer_.on_calc_block_hash(result.checksum());
+    if (digests.sha256 && !pipeline_failed) {
+      writer_.on_calc_file_sha256(file_sha256.hex_digest());
     }
   } catch (const std::exception& e) {
     writer_.on_pipeline_failure();
     std::unique_lock lk{mt};
     failed = true;
     lk.unlock();
+    space_cv.notify_one();
 
     std::throw_with_nested(error(e.what()));
   }
@@ -177,8 +319,12 @@ void hash_calc_impl::run() {
 //
 // writer_impl
 //
-writer_impl::writer_impl(const std::string& output_file)
+writer_impl::writer_impl(const std::string& output_file, digest_set digests,
+                         signature_header header)
     : output_file{output_file},
+      digests{digests},
+      tail_offset{0},
+      sig{std::move(header), {}, {}, {}},
       hash_calc_finished{false},
       pipeline_failed{false} {}
 
@@ -188,11 +334,33 @@ void writer_impl::on_calc_block_hash(int hash) {
     return;
   }
 
-  crc.push_back(hash);
+  sig.crc32.push_back(hash);
+  lk.unlock();
+  cv.notify_one();
+}
+
+void writer_impl::on_calc_block_digests(const block_digests& d) {
+  std::unique_lock lk{mt};
+  if (pipeline_failed) {
+    return;
+  }
+
+  sig.crc32.push_back(d.crc32);
+  if (digests.crc32c) {
+    sig.crc32c.push_back(d.crc32c);
+  }
+  if (digests.xxh64) {
+    sig.xxh64.push_back(d.xxh64);
+  }
   lk.unlock();
   cv.notify_one();
 }
 
+void writer_impl::on_calc_file_sha256(const std::string& hex) {
+  std::unique_lock lk{mt};
+  sig.header["sha256"] = hex;
+}
+
 void writer_impl::on_finishing_hash_calc() {
   std::unique_lock lk{mt};
   hash_calc_finished = true;
@@ -207,6 +375,10 @@ void writer_impl::on_pipeline_failure() {
   cv.notify_one();
 }
 
+void writer_impl::resume_at(std::uint64_t tail_offset) {
+  this->tail_offset = tail_offset;
+}
+
 void writer_impl::run() {
   try {
     while (true) {
@@ -223,25 +395,195 @@ void writer_impl::run() {
     }
 
     std::unique_lock lk{mt};
+    finish_header(sig, digests);
 
-    std::ofstream s;
+    if (tail_offset > 0) {
+      write_signature_tail(output_file, sig, tail_offset);
+    } else {
+      write_signature(output_file, sig);
+    }
+    return;
+  } catch (const std::exception& e) {
+    std::throw_with_nested(error(e.what()));
+  }
+}
 
-    try {
-      s.exceptions(std::ifstream::badbit | std::ios_base::failbit);
-      s.open(output_file, std::ios::trunc | std::ios::out);
-    } catch (std::exception& e) {
-      std::throw_with_nested(error("Couldn't open " + output_file));
+std::uint64_t mix64(std::uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+std::string format_header(const signature_header& h) {
+  std::string line = "# file_signature";
+  for (const auto& f : h) {
+    line += ' ' + f.first + '=' + f.second;
+  }
+  return line;
+}
+
+bool parse_header(const std::string& line, signature_header& h) {
+  std::istringstream s{line};
+  std::string hash_sign, name;
+  if (!(s >> hash_sign >> name) || hash_sign != "#" ||
+      name != "file_signature") {
+    return false;
+  }
+
+  h.clear();
+  std::string field;
+  while (s >> field) {
+    auto eq = field.find('=');
+    if (eq == std::string::npos) {
+      return false;
     }
+    h[field.substr(0, eq)] = field.substr(eq + 1);
+  }
+
+  return true;
+}
+
+int block_hash(const char* data, std::size_t size) {
+  boost::crc_32_type result;
+  result.process_bytes(data, size);
+  return result.checksum();
+}
+
+std::string digest_columns(const digest_set& digests) {
+  std::string columns = "crc32";
+  columns += digests.crc32c ? ",crc32c" : "";
+  columns += digests.xxh64 ? ",xxh64" : "";
+  return columns;
+}
+
+void finish_header(signature& sig, const digest_set& digests,
+                   sha256* file_sha256) {
+  // plain signatures keep the headerless format
+  if (digests.crc32c || digests.xxh64 || digests.sha256) {
+    sig.header.emplace("mode", "full");
+    sig.header["digests"] = digest_columns(digests);
+  }
+  if (digests.sha256 && file_sha256) {
+    sig.header["sha256"] = file_sha256->hex_digest();
+  }
+}
+
+namespace {
 
-    for (auto i = crc.begin(); i != crc.end(); i++) {
-      s << *i << '\n';
+void write_blocks(std::ostream& s, const signature& sig) {
+  for (std::size_t i = 0; i < sig.crc32.size(); i++) {
+    s << sig.crc32[i];
+    if (!sig.crc32c.empty()) {
+      s << ' ' << sig.crc32c[i];
     }
+    if (!sig.xxh64.empty()) {
+      s << ' ' << sig.xxh64[i];
+    }
+    s << '\n';
+  }
+}
+
+}  // namespace
+
+void write_signature(const std::string& output_file, const signature& sig) {
+  std::ofstream s;
+
+  try {
+    s.exceptions(std::ifstream::badbit | std::ios_base::failbit);
+    s.open(output_file, std::ios::trunc | std::ios::out);
+  } catch (std::exception& e) {
+    std::throw_with_nested(error("Couldn't open " + output_file));
+  }
+
+  if (!sig.header.empty()) {
+    s << format_header(sig.header) << '\n';
+  }
+
+  write_blocks(s, sig);
+  s.close();
+}
+
+void write_signature_tail(const std::string& output_file, const signature& sig,
+                          std::uint64_t tail_offset) {
+  try {
+    std::filesystem::resize_file(output_file, tail_offset);
+
+    std::fstream s;
+    s.exceptions(std::ifstream::badbit | std::ios_base::failbit);
+    s.open(output_file, std::ios::in | std::ios::out);
+
+    std::string old_header;
+    std::getline(s, old_header);
+    auto header = format_header(sig.header);
+    if (header.size() != old_header.size()) {
+      throw error("the header of " + output_file + " changed its length");
+    }
+
+    s.seekp(0, std::ios::end);
+    write_blocks(s, sig);
+
+    // the header goes last, until then it describes the blocks kept, and a
+    // signature whose block count doesn't match is signed again
+    s.seekp(0);
+    s << header;
     s.close();
+  } catch (std::exception& e) {
+    std::throw_with_nested(error("Couldn't update " + output_file));
+  }
+}
 
-    return;
-  } catch (const std::exception& e) {
-    std::throw_with_nested(error(e.what()));
+signature read_signature(const std::string& signature_file) {
+  std::ifstream s;
+
+  try {
+    s.exceptions(std::ifstream::badbit | std::ios_base::failbit);
+    s.open(signature_file, std::ios::in);
+    s.exceptions(std::ifstream::badbit);
+  } catch (std::exception& e) {
+    std::throw_with_nested(error("Couldn't open " + signature_file));
+  }
+
+  signature sig;
+  std::string line;
+  bool first = true;
+  bool has_crc32c = false;
+  bool has_xxh64 = false;
+
+  while (std::getline(s, line)) {
+    if (first && parse_header(line, sig.header)) {
+      if (sig.header["mode"] == "sampled") {
+        throw error(signature_file + " is a sampled signature");
+      }
+      auto columns = sig.header.find("digests");
+      if (columns != sig.header.end()) {
+        has_crc32c = columns->second.find("crc32c") != std::string::npos;
+        has_xxh64 = columns->second.find("xxh64") != std::string::npos;
+      }
+      first = false;
+      continue;
+    }
+    first = false;
+
+    std::istringstream l{line};
+    int crc32;
+    std::uint32_t crc32c;
+    std::uint64_t xxh64;
+    if (!(l >> crc32) || (has_crc32c && !(l >> crc32c)) ||
+        (has_xxh64 && !(l >> xxh64))) {
+      throw error("Couldn't parse " + signature_file + ": " + line);
+    }
+
+    sig.crc32.push_back(crc32);
+    if (has_crc32c) {
+      sig.crc32c.push_back(crc32c);
+    }
+    if (has_xxh64) {
+      sig.xxh64.push_back(xxh64);
+    }
   }
+
+  return sig;
 }
 
 //
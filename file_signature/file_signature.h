@@ -1,8 +1,23 @@
 #ifndef FILE_SIGNATURE_FILE_SIGNATURE_H_
 #define FILE_SIGNATURE_FILE_SIGNATURE_H_
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <ostream>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace file_signature {
 
@@ -10,9 +25,299 @@ struct error : public std::runtime_error {
   explicit error(const std::string& s);
 };
 
+// digests computed in the same pass as the crc32 of every block
+struct digest_set {
+  bool crc32c = false;
+  bool xxh64 = false;
+  // of the whole file
+  bool sha256 = false;
+};
+
+// digests of one block; crc32c and xxh64 are 0 unless enabled
+struct block_digests {
+  int crc32;
+  std::uint32_t crc32c;
+  std::uint64_t xxh64;
+};
+
+struct options {
+  digest_set digests;
+  // signs only length bytes (0 for the rest of the file) starting at offset,
+  // both multiples of the block size, into a shard signature for merge()
+  bool shard = false;
+  std::uint64_t offset = 0;
+  std::uint64_t length = 0;
+  // pins the pipeline threads to the cpus of this node so block buffers are
+  // allocated and hashed node-locally; -1 leaves placement to the scheduler
+  int numa_node = -1;
+  // reuses signatures of unchanged inputs stored in this directory, keyed by
+  // device, inode, size, mtime, block size and digests
+  std::string cache_dir;
+  // bytes of cached signatures kept, least recently used ones are removed
+  // first; 0 for no limit
+  std::uint64_t cache_limit = 0;
+  // extends a signature written by an earlier append run of a growing file
+  // by hashing only the bytes added since; the first and the last block the
+  // earlier run covered and append_check_blocks pseudo-random ones are
+  // rehashed first, and the whole file is signed again when one differs
+  bool append = false;
+  std::uint64_t append_check_blocks = 0;
+};
+
+struct numa_node_info {
+  int node;
+  std::vector<int> cpus;
+};
+
+struct stats {
+  std::uint64_t blocks = 0;
+  std::uint64_t bytes = 0;
+  double seconds = 0;
+  // node the pipeline was bound to, -1 when none was asked for or its cpus
+  // were refused
+  int numa_node = -1;
+  std::vector<numa_node_info> topology;
+  std::uint64_t cache_hits = 0;
+  std::uint64_t cache_misses = 0;
+};
+
 void generate(std::string input_file, std::string signature_file,
               int block_size);
 
+void generate(std::string input_file, std::string signature_file,
+              int block_size, const options& opts, stats* st = nullptr);
+
+// a piece of an input the caller holds in memory
+struct memory_chunk {
+  const char* data;
+  std::size_t size;
+};
+
+// gets the digests of the blocks in order
+using digest_sink = std::function<void(const block_digests&)>;
+
+// signs an input the caller already holds without copying it; blocks are
+// hashed by the calling thread and a thread pool shared by all the calls, a
+// block may span chunks, and the sink is called on the calling thread.
+// Returns the sha256 hex of the whole input when digests.sha256 is set
+std::string generate(const char* data, std::size_t size, int block_size,
+                     const digest_sink& sink, const digest_set& digests = {});
+std::string generate(const std::vector<memory_chunk>& chunks, int block_size,
+                     const digest_sink& sink, const digest_set& digests = {});
+
+// writes the digests to out, which has room for out_size blocks
+std::string generate(const char* data, std::size_t size, int block_size,
+                     block_digests* out, std::size_t out_size,
+                     const digest_set& digests = {});
+std::string generate(const std::vector<memory_chunk>& chunks, int block_size,
+                     block_digests* out, std::size_t out_size,
+                     const digest_set& digests = {});
+
+struct sample_options {
+  // hash every stride-th block, 0 to skip
+  std::uint64_t stride = 0;
+  // and count blocks chosen pseudo-randomly from seed
+  std::uint64_t count = 0;
+  std::uint64_t seed = 0;
+};
+
+// quick fingerprint of the first and the last block plus the blocks chosen
+// by sample_options; the signature is marked as sampled in its header and
+// lists "<block index> <hash>", so it isn't comparable with a full one
+void sample(std::string input_file, std::string signature_file,
+            int block_size, const sample_options& opts);
+
+// runs a task later on some thread; it must not run the task inline, the
+// tasks of a job post each other
+using executor = std::function<void(std::function<void()>)>;
+
+// reads, hashes and writes as short tasks on the executor instead of
+// blocking three threads, so many jobs can share a few threads
+std::future<void> generate_async(std::string input_file,
+                                 std::string signature_file, int block_size,
+                                 executor ex);
+
+// gets nullptr when the job succeeded, otherwise its error
+using completion = std::function<void(std::exception_ptr)>;
+
+// the same without a thread waiting for the result: on_done is posted on the
+// executor when the job is over
+void generate_async(std::string input_file, std::string signature_file,
+                    int block_size, executor ex, completion on_done);
+
+class thread_pool {
+ public:
+  explicit thread_pool(unsigned threads = std::thread::hardware_concurrency());
+  // runs the tasks that are already queued before joining the threads
+  ~thread_pool();
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+  void post(std::function<void()> task);
+  executor get_executor();
+
+ private:
+  void run();
+
+  std::mutex mt;
+  std::condition_variable cv;
+  std::deque<std::function<void()>> tasks;
+  bool stopping;
+  std::vector<std::thread> threads;
+};
+
+class async_job;
+class job_scheduler;
+
+// a job submitted to an engine
+class job {
+ public:
+  // throws if the job failed or was cancelled
+  void get();
+  void wait() const;
+  // stops the job between blocks; a job which has already finished isn't
+  // affected
+  void cancel();
+
+ private:
+  friend class engine;
+  job(std::shared_ptr<async_job> impl, std::future<void> result);
+
+  std::shared_ptr<async_job> impl;
+  std::future<void> result;
+};
+
+struct engine_config {
+  unsigned threads = std::thread::hardware_concurrency();
+  // bytes of block buffers all the jobs hold at once
+  std::uint64_t memory_budget = 64 << 20;
+  // blocks being read at once
+  unsigned max_reads = 2;
+};
+
+// long-lived signer for services which sign many files: the jobs share the
+// threads and the block buffers, and each job waits in line for its next
+// read, so a large file doesn't hold back the small ones
+class engine {
+ public:
+  explicit engine(engine_config config = {});
+  // cancels the unfinished jobs and waits for their tasks
+  ~engine();
+  engine(const engine&) = delete;
+  engine& operator=(const engine&) = delete;
+
+  // takes the same options as generate() except numa_node and append, which
+  // throw error; the threads of the engine are shared by all the jobs
+  job submit(std::string input_file, std::string signature_file,
+             int block_size, const options& opts = {});
+
+ private:
+  std::unique_ptr<job_scheduler> scheduler;
+  std::mutex mt;
+  std::vector<std::weak_ptr<async_job>> jobs;
+  // destroyed first, its tasks use the scheduler
+  thread_pool pool;
+};
+
+// joins shard signatures that together cover the whole file without gaps
+// into the signature a single generate() run writes
+void merge(const std::vector<std::string>& shard_files,
+           std::string signature_file);
+
+std::vector<numa_node_info> numa_topology();
+
+void print_stats(std::ostream& s, const stats& st);
+
+struct dedup_group {
+  // xxh64 of the blocks
+  std::uint64_t digest;
+  int first_file;
+  std::uint64_t first_block;
+  std::uint64_t count;
+};
+
+struct dedup_file_stats {
+  std::string input_file;
+  std::uint64_t blocks;
+  // a lower bound unless the report is exact
+  std::uint64_t duplicate_blocks;
+  // blocks whose digest didn't fit into the index and were only counted by
+  // the sketch, so it is unknown whether they are duplicates
+  std::uint64_t untracked_blocks;
+};
+
+struct dedup_report {
+  std::uint64_t total_blocks;
+  double distinct_blocks;
+  // false when the index reached its limit: distinct_blocks is a sketch
+  // estimate, and duplicates among the untracked blocks are missing from the
+  // groups and the duplicate counts
+  bool exact;
+  double ratio;
+  std::vector<dedup_group> groups;
+  std::vector<dedup_file_stats> files;
+};
+
+// signs every input_files[i] into signature_files[i] and builds an index of
+// the xxh64 of every block across all of them, crc32 would collide after
+// some 100k distinct blocks; the index takes at most max_index_bytes, some
+// 128 bytes per distinct digest, the rest are counted by a HyperLogLog sketch
+dedup_report dedup(const std::vector<std::string>& input_files,
+                   const std::vector<std::string>& signature_files,
+                   int block_size, std::uint64_t max_index_bytes);
+
+void print_dedup_report(std::ostream& s, const dedup_report& report);
+
+// keeps signature files up to date while their input files change.
+// inotify doesn't report which byte ranges were modified, so a changed input
+// is resigned as a whole, while inputs with the same size and mtime as on
+// the previous pass are never reread
+class watcher {
+ public:
+  using error_handler = std::function<void(const std::exception&)>;
+
+  static constexpr std::chrono::milliseconds settle_time{200};
+
+  watcher(const std::vector<std::string>& input_files,
+          const std::vector<std::string>& signature_files, int block_size,
+          error_handler on_error = {});
+  ~watcher();
+  watcher(const watcher&) = delete;
+  watcher& operator=(const watcher&) = delete;
+
+  // signs all inputs and then waits for changes until stop() is called
+  void run();
+  // async-signal-safe
+  void stop();
+  std::uint64_t updates() const { return updates_; }
+
+ private:
+  struct target {
+    std::string input_file;
+    std::string signature_file;
+    std::string dir;
+    std::string name;
+    bool known = false;
+    std::uint64_t size = 0;
+    std::int64_t mtime_ns = 0;
+    bool dirty = false;
+    // of the last modification, the input is signed once it's quiet for
+    // settle_time
+    std::chrono::steady_clock::time_point last_write;
+  };
+
+  void read_events();
+  void update(target& t);
+
+  std::vector<target> targets;
+  std::vector<std::pair<int, std::string>> watches;
+  int block_size;
+  error_handler on_error;
+  int inotify_fd;
+  int stop_fds[2];
+  std::atomic<std::uint64_t> updates_;
+};
+
 }  // namespace file_signature
 
 #endif  // FILE_SIGNATURE_FILE_SIGNATURE_H_
@@ -1,15 +1,100 @@
 #ifndef FILE_SIGNATURE_FILE_SIGNATURE_IMPL_H_
 #define FILE_SIGNATURE_FILE_SIGNATURE_IMPL_H_
 
+#include <file_signature/file_signature.h>
+
+#include <array>
+#include <boost/crc.hpp>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <queue>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace file_signature {
 
 using file_block = std::vector<char>;
 
+// first line of signatures which aren't a plain list of block hashes,
+// "# file_signature key=value ..."
+using signature_header = std::map<std::string, std::string>;
+
+std::string format_header(const signature_header& h);
+bool parse_header(const std::string& line, signature_header& h);
+
+// a line per block with crc32 followed by the crc32c and xxh64 columns
+// which aren't empty
+struct signature {
+  signature_header header;
+  std::vector<int> crc32;
+  std::vector<std::uint32_t> crc32c;
+  std::vector<std::uint64_t> xxh64;
+};
+
+class sha256 {
+ public:
+  sha256();
+  void update(const char* data, std::size_t size);
+  // finishes the digest, update() can't be called afterwards
+  std::string hex_digest();
+
+ private:
+  void transform(const unsigned char* block);
+
+  std::array<std::uint32_t, 8> state;
+  std::array<unsigned char, 64> buffer;
+  std::size_t buffered;
+  std::uint64_t length;
+};
+
+class xxh64 {
+ public:
+  explicit xxh64(std::uint64_t seed = 0);
+  void update(const char* data, std::size_t size);
+  std::uint64_t digest() const;
+
+ private:
+  std::uint64_t seed;
+  std::array<std::uint64_t, 4> acc;
+  std::array<unsigned char, 32> buffer;
+  std::size_t buffered;
+  std::uint64_t length;
+};
+
+// calc_block_digests() of a block given piece by piece
+class block_hasher {
+ public:
+  explicit block_hasher(const digest_set& digests);
+  void update(const char* data, std::size_t size);
+  block_digests digests() const;
+
+ private:
+  using crc_32c_type =
+      boost::crc_optimal<32, 0x1EDC6F41, 0xFFFFFFFF, 0xFFFFFFFF, true, true>;
+
+  digest_set enabled;
+  boost::crc_32_type crc32;
+  crc_32c_type crc32c;
+  xxh64 x;
+};
+
+// feeds the block to every digest chunk by chunk, so each chunk is still in
+// cache for the next digest
+block_digests calc_block_digests(const char* data, std::size_t size,
+                                 const digest_set& digests,
+                                 sha256* file_sha256);
+
 struct hash_calc {
   virtual ~hash_calc() = default;
   virtual void on_read_block(file_block) = 0;
@@ -20,24 +105,41 @@ struct hash_calc {
 struct writer {
   virtual ~writer() = default;
   virtual void on_calc_block_hash(int hash) = 0;
+  // writers which don't keep the extra digests get only crc32
+  virtual void on_calc_block_digests(const block_digests& d) {
+    on_calc_block_hash(d.crc32);
+  }
+  virtual void on_calc_file_sha256(const std::string&) {}
   virtual void on_finishing_hash_calc() = 0;
   virtual void on_pipeline_failure() = 0;
 };
 
 class reader {
  public:
-  reader(const std::string& input_file, int block_size, hash_calc&);
+  // reads length bytes (0 for the rest of the file) starting at offset
+  reader(const std::string& input_file, int block_size, hash_calc&,
+         std::uint64_t offset = 0, std::uint64_t length = 0);
   void run();
+  std::uint64_t blocks_read() const { return blocks; }
+  std::uint64_t bytes_read() const { return bytes; }
 
  private:
   std::string input_file;
   hash_calc& calc;
   int block_size;
+  std::uint64_t offset;
+  std::uint64_t length;
+  std::uint64_t blocks;
+  std::uint64_t bytes;
 };
 
 class hash_calc_impl : public hash_calc {
  public:
-  explicit hash_calc_impl(writer&);
+  // the reader waits when this many blocks are queued, so memory doesn't
+  // grow with the input size when hashing is slower than reading
+  static constexpr std::size_t max_queued_blocks = 16;
+
+  explicit hash_calc_impl(writer&, digest_set digests = {});
   void on_read_block(file_block) override;
   void on_finishing_reader() override;
   void on_pipeline_failure() override;
@@ -45,8 +147,11 @@ class hash_calc_impl : public hash_calc {
 
  private:
   writer& writer_;
+  digest_set digests;
+  sha256 file_sha256;
   std::mutex mt;
   std::condition_variable cv;
+  std::condition_variable space_cv;
   std::queue<file_block> blocks;
   bool reader_finished;
   bool failed;
@@ -55,30 +160,301 @@ class hash_calc_impl : public hash_calc {
 
 class writer_impl : public writer {
  public:
-  explicit writer_impl(const std::string& output_file);
+  // header fields are written as given, others are added for extra digests
+  explicit writer_impl(const std::string& output_file,
+                       digest_set digests = {}, signature_header header = {});
   void on_calc_block_hash(int hash) override;
+  void on_calc_block_digests(const block_digests& d) override;
+  void on_calc_file_sha256(const std::string& hex) override;
   void on_finishing_hash_calc() override;
   void on_pipeline_failure() override;
+  // keeps the first tail_offset bytes of the output file instead of
+  // truncating it, see write_signature_tail()
+  void resume_at(std::uint64_t tail_offset);
   void run();
 
  private:
   std::string output_file;
+  digest_set digests;
+  std::uint64_t tail_offset;
   std::mutex mt;
   std::condition_variable cv;
-  std::vector<int> crc;
+  signature sig;
   bool hash_calc_finished;
   bool pipeline_failed;
 };
 
+// mode=shard header with the [first_block, end_block) range the shard of
+// opts covers
+signature_header shard_header(const std::string& input_file, int block_size,
+                              const options& opts);
+
+// sorted block indices a sampled signature covers
+std::vector<std::uint64_t> sample_blocks(std::uint64_t blocks,
+                                         const sample_options& opts);
+
+// splitmix64 finalizer
+std::uint64_t mix64(std::uint64_t x);
+
+int block_hash(const char* data, std::size_t size);
+
+// "crc32,crc32c,xxh64" for the enabled columns
+std::string digest_columns(const digest_set& digests);
+
+// adds the header of a full signature with extra digests, plain signatures
+// keep the headerless format; file_sha256 is finished into it when given
+void finish_header(signature& sig, const digest_set& digests,
+                   sha256* file_sha256 = nullptr);
+
+void write_signature(const std::string& output_file, const signature& sig);
+
+// keeps the first tail_offset bytes of the output file, appends the blocks
+// of sig after them and then rewrites the header, which must keep its length
+void write_signature_tail(const std::string& output_file, const signature& sig,
+                          std::uint64_t tail_offset);
+
+// reads a full or a shard signature, the columns come from the header
+signature read_signature(const std::string& signature_file);
+
+// returns numa_node when all the threads were bound to it, -1 otherwise
+int run_pipeline(reader&, hash_calc_impl&, writer_impl&, int numa_node = -1);
+
 class generator {
  public:
-  generator(std::string input_file, std::string signature_file, int block_size);
+  generator(std::string input_file, std::string signature_file, int block_size,
+            options opts = {}, stats* st = nullptr);
   void run();
 
  private:
+  void sign();
+  void append();
+  // signs length bytes (0 for the rest of the file) starting at offset; a
+  // tail_offset other than 0 resumes the signature file there
+  void sign_range(signature_header header, std::uint64_t offset,
+                  std::uint64_t length, std::uint64_t tail_offset = 0);
+
   std::string input_file;
   std::string signature_file;
   int block_size;
+  options opts;
+  stats* st;
+};
+
+struct file_identity {
+  std::uint64_t dev;
+  std::uint64_t ino;
+  std::uint64_t size;
+  std::int64_t mtime_ns;
+
+  bool operator==(const file_identity& o) const {
+    return dev == o.dev && ino == o.ino && size == o.size &&
+           mtime_ns == o.mtime_ns;
+  }
+};
+
+file_identity stat_identity(const std::string& file);
+
+// directory of "<key>.signature" files; entries are published by rename, so
+// several processes can share it, and the mtime of an entry is its last use.
+// evict() also removes the temporary files of stores that were interrupted
+class signature_cache {
+ public:
+  signature_cache(std::string dir, std::uint64_t limit);
+  // copies the cached signature to signature_file
+  bool lookup(const std::string& key, const std::string& signature_file);
+  // false when the entry couldn't be stored; the cache is optional, callers
+  // don't fail the signing for it
+  bool store(const std::string& key, const std::string& signature_file);
+
+  static std::string key(const file_identity& id, int block_size,
+                         const options& opts);
+  // false while the mtime of id is within the timestamp granularity of now:
+  // a write right after the signature may not change it, and the stale
+  // entry would be found again
+  static bool cacheable(const file_identity& id);
+
+ private:
+  void evict();
+
+  std::string dir;
+  std::uint64_t limit;
+};
+
+// the cache lookup before signing an input and the store after it
+class cached_input {
+ public:
+  cached_input(std::string input_file, int block_size, const options& opts);
+  // copies the cached signature of the input to signature_file
+  bool lookup(const std::string& signature_file);
+  // an input written while it was read, or that may be written without
+  // changing its mtime, isn't stored
+  void store(const std::string& signature_file);
+
+ private:
+  signature_cache cache;
+  std::string input_file;
+  file_identity identity;
+  std::string key;
+};
+
+// shared by the jobs of an engine: admits reads in the order they were
+// requested while the read and memory budgets allow, and keeps the block
+// buffers of finished reads for the next ones
+class job_scheduler {
+ public:
+  job_scheduler(std::uint64_t memory_budget, unsigned max_reads);
+  // calls admitted, which must not block, once a read holding bytes of
+  // memory may start; right away or from a later release()
+  void request_read(std::uint64_t bytes, std::function<void()> admitted);
+  // the read is done, its memory is held until release()
+  void finish_read();
+  void release(std::uint64_t bytes);
+
+  file_block acquire_buffer(std::size_t size);
+  // keeps b while the pool and the reads holding memory fit in the budget
+  void recycle_buffer(file_block b);
+
+ private:
+  void admit(std::unique_lock<std::mutex>& lk);
+
+  std::uint64_t memory_budget;
+  unsigned max_reads;
+  std::mutex mt;
+  std::deque<std::pair<std::uint64_t, std::function<void()>>> waiting;
+  std::uint64_t memory_used;
+  unsigned reads;
+  std::vector<file_block> buffers;
+  std::uint64_t buffered_bytes;
+};
+
+// one generate_async() call or engine job; every step is a task on the
+// executor which holds a reference to the job and posts the steps that can
+// follow it
+class async_job : public std::enable_shared_from_this<async_job> {
+ public:
+  // blocks read ahead of the hashing, bounds the memory of a job
+  static constexpr int max_in_flight = 4;
+
+  // without a scheduler the job reads as soon as it has room for a block
+  async_job(std::string input_file, std::string signature_file, int block_size,
+            options opts, executor ex, job_scheduler* scheduler = nullptr);
+  std::future<void> start();
+  // reports the result to on_done instead of a future
+  void start(completion on_done);
+  void cancel();
+
+ private:
+  // runs step on the executor, failing the job if it throws
+  void post(std::function<void()> step);
+  void begin();
+  void request_read();
+  void read();
+  void hash(std::size_t index, file_block b);
+  void write();
+  void release_block(file_block b);
+  void finish();
+  void fail();
+  void fail(std::exception_ptr e);
+
+  std::string input_file;
+  std::string signature_file;
+  int block_size;
+  options opts;
+  executor ex;
+  job_scheduler* scheduler;
+  std::optional<cached_input> cache;
+  std::ifstream s;
+  // left of the shard when opts.length is set
+  std::uint64_t remaining;
+  // updated by the reads, which follow each other
+  sha256 file_sha256;
+  std::mutex mt;
+  signature sig;
+  int in_flight;
+  bool read_paused;
+  bool reader_finished;
+  bool finished;
+  std::promise<void> result;
+  completion on_done;
+};
+
+// "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}
+std::vector<int> parse_cpu_list(const std::string& list);
+
+std::vector<int> numa_node_cpus(int node);
+
+// restricts the calling thread to the cpus; with the cpus of one node the
+// memory the thread touches first is allocated on that node. false when the
+// thread may not run on them
+bool bind_to_cpus(const std::vector<int>& cpus);
+
+class hll_sketch {
+ public:
+  static constexpr int precision = 14;
+
+  hll_sketch();
+  void add(std::uint64_t digest);
+  double estimate() const;
+
+ private:
+  std::array<std::uint8_t, 1 << precision> registers;
+};
+
+// open-addressing (linear probing) index of 64-bit block digests which
+// remembers where a digest was seen first and how many times
+class dedup_index {
+ public:
+  struct entry {
+    std::uint64_t digest;
+    std::uint64_t first_block;
+    std::uint64_t count;
+    std::uint32_t first_file;
+  };
+
+  enum class result { first, duplicate, untracked };
+
+  // the table is at most 3/4 full and grows by doubling while the old one is
+  // still held, so at worst an entry takes 8/3 slots of the new table and
+  // 4/3 of the old one
+  static constexpr std::size_t peak_bytes_per_entry = 4 * sizeof(entry);
+  // entries whose index stays within max_bytes at its peak
+  static std::size_t entries_for(std::uint64_t max_bytes);
+
+  explicit dedup_index(std::size_t max_entries);
+  result insert(std::uint64_t digest, int file, std::uint64_t block);
+
+  std::size_t size() const { return used; }
+  bool overflowed() const { return overflow; }
+  double distinct_estimate() const { return sketch.estimate(); }
+  const std::vector<entry>& entries() const { return table; }
+
+ private:
+  std::size_t find_slot(std::uint64_t digest) const;
+  void grow();
+
+  std::size_t max_entries;
+  std::vector<entry> table;
+  std::size_t used;
+  bool overflow;
+  hll_sketch sketch;
+};
+
+// forwards the crc32 of the blocks to the next writer and feeds their xxh64,
+// which the hash calc must compute, into the dedup index
+class dedup_writer : public writer {
+ public:
+  dedup_writer(writer& next, dedup_index& index, int file,
+               dedup_file_stats& stats);
+  void on_calc_block_hash(int hash) override;
+  void on_calc_block_digests(const block_digests& d) override;
+  void on_finishing_hash_calc() override;
+  void on_pipeline_failure() override;
+
+ private:
+  writer& next;
+  dedup_index& index;
+  int file;
+  dedup_file_stats& stats;
 };
 
 }  // namespace file_signature
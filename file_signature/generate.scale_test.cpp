@@ -0,0 +1,199 @@
+#include <file_signature/file_signature.h>
+#include <file_signature/file_signature.test.h>
+#include <gtest/gtest.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <boost/crc.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// The sizes, the memory cap and the baseline can be overridden with the
+// FILE_SIGNATURE_SCALE_* environment variables read below. The throughput
+// check needs FILE_SIGNATURE_SCALE_BASELINE, a file holding the MiB/s of a
+// reference run on the same machine; FILE_SIGNATURE_SCALE_RECORD_BASELINE
+// makes a run write its throughput to that file instead of checking it.
+
+namespace {
+
+const char sparse_file[] = "scale_sparse.bin";
+const char random_file[] = "scale_random.bin";
+const char scale_signature[] = "scale.signature";
+const int block_size = 1 << 20;
+
+std::uint64_t env_or(const char* name, std::uint64_t value) {
+  auto v = std::getenv(name);
+  return v ? std::strtoull(v, nullptr, 10) : value;
+}
+
+std::uint64_t sparse_bytes() {
+  return env_or("FILE_SIGNATURE_SCALE_SPARSE_BYTES", 2ULL << 30);
+}
+
+std::uint64_t random_bytes() {
+  return env_or("FILE_SIGNATURE_SCALE_RANDOM_BYTES", 64ULL << 20);
+}
+
+std::uint64_t memory_cap() {
+  return env_or("FILE_SIGNATURE_SCALE_MEMORY_CAP", 1ULL << 30);
+}
+
+// peak RSS allowed for generate, it doesn't depend on the input size
+std::uint64_t rss_bound() {
+  return env_or("FILE_SIGNATURE_SCALE_RSS_BOUND",
+                (64ULL << 20) + 2 * 16 * block_size);
+}
+
+void create_sparse_file(const std::string& name, std::uint64_t size) {
+  {
+    std::ofstream f(name, std::ios::binary | std::ios::trunc | std::ios::out);
+  }
+  std::filesystem::resize_file(name, size);
+
+  // a few non-zero blocks so that not every block hash is the same
+  std::fstream f(name, std::ios::binary | std::ios::in | std::ios::out);
+  for (std::uint64_t offset = 0; offset + 5 <= size;
+       offset += size / 7 + 1) {
+    f.seekp(offset);
+    f << "scale";
+  }
+}
+
+void create_random_file(const std::string& name, std::uint64_t size) {
+  std::ofstream f(name, std::ios::binary | std::ios::trunc | std::ios::out);
+  std::mt19937_64 rng{42};
+  std::vector<std::uint64_t> chunk(1 << 16);
+
+  while (size > 0) {
+    for (auto& v : chunk) {
+      v = rng();
+    }
+    auto n = std::min<std::uint64_t>(size, chunk.size() * sizeof(chunk[0]));
+    f.write(reinterpret_cast<const char*>(chunk.data()), n);
+    size -= n;
+  }
+}
+
+// single-threaded reference the pipeline output must match
+std::vector<std::string> reference_signature(const std::string& name) {
+  std::ifstream s(name, std::ios::binary | std::ios::in);
+  std::vector<char> buffer(block_size);
+  std::vector<std::string> result;
+
+  while (s) {
+    s.read(buffer.data(), buffer.size());
+    if (s.gcount() == 0) {
+      break;
+    }
+
+    boost::crc_32_type crc;
+    crc.process_bytes(buffer.data(), s.gcount());
+    result.push_back(std::to_string(static_cast<int>(crc.checksum())));
+  }
+
+  return result;
+}
+
+struct capped_run {
+  bool succeeded;
+  std::uint64_t max_rss;
+  double seconds;
+};
+
+// runs generate in a child process whose address space is capped below the
+// input size, so buffering the whole input can't succeed
+capped_run generate_capped(const std::string& input) {
+  auto started = std::chrono::steady_clock::now();
+
+  auto pid = fork();
+  if (pid == 0) {
+    rlimit limit{memory_cap(), memory_cap()};
+    setrlimit(RLIMIT_AS, &limit);
+
+    try {
+      file_signature::generate(input, scale_signature, block_size);
+    } catch (std::exception&) {
+      _exit(1);
+    }
+    _exit(0);
+  }
+
+  int status = 0;
+  rusage usage{};
+  wait4(pid, &status, 0, &usage);
+
+  return {WIFEXITED(status) && WEXITSTATUS(status) == 0,
+          static_cast<std::uint64_t>(usage.ru_maxrss) * 1024,
+          std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                        started)
+              .count()};
+}
+
+// a missing baseline fails the check, a run which compares with nothing
+// mustn't pass as a regression check
+void check_throughput(double mib_per_second) {
+  if (auto record = std::getenv("FILE_SIGNATURE_SCALE_RECORD_BASELINE")) {
+    std::ofstream out{record, std::ios::trunc | std::ios::out};
+    out << mib_per_second << '\n';
+    ASSERT_TRUE(out) << "couldn't write " << record;
+    std::cout << "recorded throughput baseline " << mib_per_second
+              << " MiB/s in " << record << '\n';
+    return;
+  }
+
+  auto name = std::getenv("FILE_SIGNATURE_SCALE_BASELINE");
+  ASSERT_NE(nullptr, name)
+      << "FILE_SIGNATURE_SCALE_BASELINE isn't set; record one with "
+         "FILE_SIGNATURE_SCALE_RECORD_BASELINE=<file>";
+
+  double baseline = 0;
+  std::ifstream in{name};
+  ASSERT_TRUE(in >> baseline) << "couldn't read a baseline from " << name;
+
+  double tolerance =
+      env_or("FILE_SIGNATURE_SCALE_TOLERANCE_PERCENT", 50) / 100.0;
+  EXPECT_GE(mib_per_second, baseline * (1 - tolerance))
+      << "baseline " << baseline << " MiB/s from " << name;
+}
+
+}  // namespace
+
+TEST(Scale, SparseFileLargerThanMemoryCap) {
+  create_sparse_file(sparse_file, sparse_bytes());
+
+  auto run = generate_capped(sparse_file);
+  ASSERT_TRUE(run.succeeded);
+  EXPECT_LT(run.max_rss, rss_bound());
+
+  check_throughput(sparse_bytes() / run.seconds / (1 << 20));
+
+  EXPECT_EQ(reference_signature(sparse_file),
+            file_signature::read_file(scale_signature));
+
+  file_signature::delete_file_for_reader(sparse_file);
+  file_signature::delete_file_for_reader(scale_signature);
+}
+
+TEST(Scale, RandomFile) {
+  create_random_file(random_file, random_bytes());
+
+  auto run = generate_capped(random_file);
+  ASSERT_TRUE(run.succeeded);
+  EXPECT_LT(run.max_rss, rss_bound());
+
+  EXPECT_EQ(reference_signature(random_file),
+            file_signature::read_file(scale_signature));
+
+  file_signature::delete_file_for_reader(random_file);
+  file_signature::delete_file_for_reader(scale_signature);
+}
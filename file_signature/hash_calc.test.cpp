@@ -2,6 +2,8 @@
 #include <file_signature/file_signature_impl.h>
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <chrono>
 #include <future>
 #include <string>
 
@@ -102,3 +104,35 @@ TEST(HashCalc, OnPipelineFailed) {
     FAIL() << e.what();
   }
 }
+
+TEST(HashCalc, ReaderWaitsForQueueSpace) {
+  try {
+    file_signature::writer_mock w;
+    file_signature::hash_calc_impl h{w};
+
+    const int n = file_signature::hash_calc_impl::max_queued_blocks * 4;
+    std::atomic<int> queued{0};
+    auto reader_result = std::async(std::launch::async, [&]() {
+      for (int i = 0; i < n; i++) {
+        h.on_read_block({'c', 'c', 'c'});
+        queued++;
+      }
+      h.on_finishing_reader();
+    });
+
+    // nothing is hashed yet, the reader blocks once the queue is full
+    ASSERT_EQ(std::future_status::timeout,
+              reader_result.wait_for(std::chrono::milliseconds(200)));
+    EXPECT_EQ(file_signature::hash_calc_impl::max_queued_blocks, queued);
+
+    h.run();
+
+    reader_result.wait();
+    reader_result.get();
+
+    std::lock_guard lk{w.mt};
+    ASSERT_EQ(w.data.size(), n);
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+}
@@ -3,17 +3,66 @@
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/parsers.hpp>
 #include <boost/program_options/variables_map.hpp>
+#include <csignal>
+#include <cstdint>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 namespace po = boost::program_options;
 
+namespace {
+
+file_signature::watcher* active_watcher = nullptr;
+
+void stop_watcher(int) {
+  if (active_watcher) {
+    active_watcher->stop();
+  }
+}
+
+}  // namespace
+
 int main(int argc, char* argv[]) {
   po::options_description desc("Allowed options");
   desc.add_options()("help", "produce help message")(
-      "input-file", po::value<std::string>(), "input file")(
-      "signature-file", po::value<std::string>(), "signature file")(
-      "block-size", po::value<int>()->default_value(1 << 20), "block size");
+      "input-file", po::value<std::vector<std::string>>(), "input file")(
+      "signature-file", po::value<std::vector<std::string>>(),
+      "signature file")("block-size",
+                        po::value<int>()->default_value(1 << 20),
+                        "block size")(
+      "dedup", "sign several input files and report duplicate blocks")(
+      "watch", "keep the signature files up to date until interrupted")(
+      "sample", po::value<std::uint64_t>(),
+      "quick sampled fingerprint of the first, the last and every Nth block")(
+      "sample-count", po::value<std::uint64_t>(),
+      "sample this many pseudo-random blocks as well")(
+      "sample-seed", po::value<std::uint64_t>()->default_value(0),
+      "seed for --sample-count")(
+      "offset", po::value<std::uint64_t>(),
+      "sign a shard starting at this byte, a multiple of the block size")(
+      "length", po::value<std::uint64_t>(),
+      "sign a shard of this many bytes, a multiple of the block size")(
+      "merge", "merge the shard signatures given as input files")(
+      "digests", po::value<std::string>()->default_value(""),
+      "extra digests computed in the same pass: crc32c,xxh64,sha256")(
+      "cache-dir", po::value<std::string>(),
+      "reuse signatures of unchanged input files stored in this directory")(
+      "cache-limit", po::value<std::uint64_t>()->default_value(0),
+      "max bytes of cached signatures, 0 for no limit")(
+      "numa-node", po::value<int>()->default_value(-1),
+      "run the pipeline on the cpus and memory of this numa node")(
+      "append",
+      "extend the signature of a growing file by hashing only the new bytes")(
+      "append-check-blocks", po::value<std::uint64_t>()->default_value(0),
+      "rehash this many pseudo-random blocks before appending")(
+      "stats", "print throughput, cache and numa statistics")(
+      "dedup-index-memory",
+      po::value<std::uint64_t>()->default_value(256 << 20),
+      "max bytes of the dedup index, 128 per distinct block; the blocks "
+      "beyond it are only estimated by a sketch");
 
   po::variables_map opts;
 
@@ -35,10 +84,116 @@ int main(int argc, char* argv[]) {
     return 1;
   }
 
+  auto input_files = opts["input-file"].as<std::vector<std::string>>();
+  auto signature_files =
+      opts["signature-file"].as<std::vector<std::string>>();
+
+  if (opts.count("dedup")) {
+    try {
+      auto report = file_signature::dedup(
+          input_files, signature_files, opts["block-size"].as<int>(),
+          opts["dedup-index-memory"].as<std::uint64_t>());
+      file_signature::print_dedup_report(std::cout, report);
+    } catch (std::exception& e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+    }
+    return 0;
+  }
+
+  if (opts.count("watch")) {
+    try {
+      file_signature::watcher w{
+          input_files, signature_files, opts["block-size"].as<int>(),
+          [](const std::exception& e) { std::cerr << e.what() << "\n"; }};
+      active_watcher = &w;
+      std::signal(SIGINT, stop_watcher);
+      std::signal(SIGTERM, stop_watcher);
+      w.run();
+      active_watcher = nullptr;
+    } catch (std::exception& e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+    }
+    return 0;
+  }
+
+  if (opts.count("merge")) {
+    if (signature_files.size() != 1) {
+      std::cout << desc << "\n";
+      return 1;
+    }
+
+    try {
+      file_signature::merge(input_files, signature_files[0]);
+    } catch (std::exception& e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+    }
+    return 0;
+  }
+
+  if (input_files.size() != 1 || signature_files.size() != 1) {
+    std::cout << desc << "\n";
+    return 1;
+  }
+
+  if (opts.count("sample") || opts.count("sample-count")) {
+    file_signature::sample_options so;
+    if (opts.count("sample")) {
+      so.stride = opts["sample"].as<std::uint64_t>();
+    }
+    if (opts.count("sample-count")) {
+      so.count = opts["sample-count"].as<std::uint64_t>();
+    }
+    so.seed = opts["sample-seed"].as<std::uint64_t>();
+
+    try {
+      file_signature::sample(input_files[0], signature_files[0],
+                             opts["block-size"].as<int>(), so);
+    } catch (std::exception& e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+    }
+    return 0;
+  }
+
   try {
-    file_signature::generate(opts["input-file"].as<std::string>(),
-                             opts["signature-file"].as<std::string>(),
-                             opts["block-size"].as<int>());
+    file_signature::options o;
+    o.numa_node = opts["numa-node"].as<int>();
+    o.append = opts.count("append") > 0;
+    o.append_check_blocks = opts["append-check-blocks"].as<std::uint64_t>();
+    if (opts.count("cache-dir")) {
+      o.cache_dir = opts["cache-dir"].as<std::string>();
+      o.cache_limit = opts["cache-limit"].as<std::uint64_t>();
+    }
+    if (opts.count("offset") || opts.count("length")) {
+      o.shard = true;
+      o.offset = opts.count("offset") ? opts["offset"].as<std::uint64_t>() : 0;
+      o.length = opts.count("length") ? opts["length"].as<std::uint64_t>() : 0;
+    }
+
+    std::istringstream digests{opts["digests"].as<std::string>()};
+    std::string d;
+    while (std::getline(digests, d, ',')) {
+      if (d == "crc32c") {
+        o.digests.crc32c = true;
+      } else if (d == "xxh64") {
+        o.digests.xxh64 = true;
+      } else if (d == "sha256") {
+        o.digests.sha256 = true;
+      } else if (d != "crc32") {
+        throw std::invalid_argument("unknown digest " + d);
+      }
+    }
+    file_signature::stats st;
+
+    file_signature::generate(input_files[0], signature_files[0],
+                             opts["block-size"].as<int>(), o, &st);
+
+    if (opts.count("stats")) {
+      file_signature::print_stats(std::cout, st);
+    }
   } catch (std::exception& e) {
     std::cerr << e.what() << "\n";
     return 1;
@@ -0,0 +1,182 @@
+#include <file_signature/file_signature.h>
+#include <file_signature/file_signature_impl.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace file_signature {
+
+namespace {
+
+// blocks hashed before their digests go to the sink, bounds the digests kept
+constexpr std::uint64_t round_blocks = 4096;
+
+unsigned hash_threads() {
+  return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+// shared by all the calls, so a round doesn't start threads; the calling
+// thread hashes a range too
+thread_pool& round_pool() {
+  static thread_pool pool{std::max(hash_threads() - 1, 1u)};
+  return pool;
+}
+
+class memory_source {
+ public:
+  explicit memory_source(const std::vector<memory_chunk>& chunks)
+      : chunks{chunks}, total{0} {
+    for (const auto& c : chunks) {
+      offsets.push_back(total);
+      total += c.size;
+    }
+  }
+
+  std::uint64_t size() const { return total; }
+
+  // calls f(data, size) for the pieces of [begin, end) in order
+  template <typename F>
+  void for_each_piece(std::uint64_t begin, std::uint64_t end, F f) const {
+    auto i = std::upper_bound(offsets.begin(), offsets.end(), begin) -
+             offsets.begin() - 1;
+
+    for (; begin < end; i++) {
+      auto n = std::min(end, offsets[i] + chunks[i].size) - begin;
+      if (n > 0) {
+        f(chunks[i].data + (begin - offsets[i]), n);
+      }
+      begin += n;
+    }
+  }
+
+ private:
+  const std::vector<memory_chunk>& chunks;
+  std::vector<std::uint64_t> offsets;
+  std::uint64_t total;
+};
+
+}  // namespace
+
+std::string generate(const char* data, std::size_t size, int block_size,
+                     const digest_sink& sink, const digest_set& digests) {
+  return generate(std::vector<memory_chunk>{{data, size}}, block_size, sink,
+                  digests);
+}
+
+std::string generate(const std::vector<memory_chunk>& chunks, int block_size,
+                     const digest_sink& sink, const digest_set& digests) {
+  if (block_size <= 0) {
+    throw error("block size must be positive");
+  }
+
+  memory_source src{chunks};
+  std::uint64_t bs = block_size;
+  auto blocks = (src.size() + bs - 1) / bs;
+  std::uint64_t threads = hash_threads();
+
+  std::vector<block_digests> round(std::min(blocks, round_blocks));
+  sha256 file_sha256;
+
+  for (std::uint64_t first = 0; first < blocks; first += round_blocks) {
+    auto n = std::min(round_blocks, blocks - first);
+    auto per_thread = (n + threads - 1) / threads;
+
+    auto hash_range = [&](std::uint64_t from, std::uint64_t to) {
+      for (auto i = from; i < to; i++) {
+        auto begin = (first + i) * bs;
+        block_hasher h{digests};
+        src.for_each_piece(begin, std::min(begin + bs, src.size()),
+                           [&h](const char* p, std::size_t size) {
+                             h.update(p, size);
+                           });
+        round[i] = h.digests();
+      }
+    };
+
+    // the calling thread takes the first range and the sha256, which has to
+    // see the bytes in order
+    std::vector<std::promise<void>> done((n - 1) / per_thread);
+    std::vector<std::future<void>> tasks;
+    for (std::uint64_t t = 0; t < done.size(); t++) {
+      tasks.push_back(done[t].get_future());
+
+      auto from = (t + 1) * per_thread;
+      round_pool().post([&hash_range, &d = done[t], from,
+                         to = std::min(n, from + per_thread)]() {
+        try {
+          hash_range(from, to);
+          d.set_value();
+        } catch (...) {
+          d.set_exception(std::current_exception());
+        }
+      });
+    }
+
+    std::exception_ptr failure;
+    try {
+      hash_range(0, std::min(n, per_thread));
+
+      if (digests.sha256) {
+        src.for_each_piece(first * bs, std::min((first + n) * bs, src.size()),
+                           [&file_sha256](const char* p, std::size_t size) {
+                             file_sha256.update(p, size);
+                           });
+      }
+    } catch (...) {
+      failure = std::current_exception();
+    }
+
+    // the tasks use this round, they finish before it's left
+    for (auto& t : tasks) {
+      t.wait();
+    }
+    if (failure) {
+      std::rethrow_exception(failure);
+    }
+    for (auto& t : tasks) {
+      t.get();
+    }
+
+    for (std::uint64_t i = 0; i < n; i++) {
+      sink(round[i]);
+    }
+  }
+
+  return digests.sha256 ? file_sha256.hex_digest() : std::string{};
+}
+
+std::string generate(const char* data, std::size_t size, int block_size,
+                     block_digests* out, std::size_t out_size,
+                     const digest_set& digests) {
+  return generate(std::vector<memory_chunk>{{data, size}}, block_size, out,
+                  out_size, digests);
+}
+
+std::string generate(const std::vector<memory_chunk>& chunks, int block_size,
+                     block_digests* out, std::size_t out_size,
+                     const digest_set& digests) {
+  if (block_size <= 0) {
+    throw error("block size must be positive");
+  }
+
+  std::uint64_t size = 0;
+  for (const auto& c : chunks) {
+    size += c.size;
+  }
+
+  if ((size + block_size - 1) / block_size > out_size) {
+    throw error("output buffer is too small for " + std::to_string(size) +
+                " bytes in blocks of " + std::to_string(block_size));
+  }
+
+  return generate(
+      chunks, block_size,
+      [&out](const block_digests& d) { *out++ = d; }, digests);
+}
+
+}  // namespace file_signature
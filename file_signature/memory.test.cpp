@@ -0,0 +1,180 @@
+#include <file_signature/file_signature.h>
+#include <file_signature/file_signature.test.h>
+#include <file_signature/file_signature_impl.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string test_data(std::size_t size) {
+  std::string data;
+  for (std::size_t i = 0; i < size; i++) {
+    data += static_cast<char>(i * 31 + i / 7);
+  }
+  return data;
+}
+
+std::vector<file_signature::block_digests> sign(
+    const std::vector<file_signature::memory_chunk>& chunks, int block_size,
+    const file_signature::digest_set& digests) {
+  std::vector<file_signature::block_digests> result;
+  file_signature::generate(
+      chunks, block_size,
+      [&result](const file_signature::block_digests& d) {
+        result.push_back(d);
+      },
+      digests);
+  return result;
+}
+
+}  // namespace
+
+TEST(Memory, SameAsFile) {
+  try {
+    auto data = test_data(20005);
+    std::ofstream{file_signature::default_input_file, std::ios::binary}
+        << data;
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10);
+    auto lines = file_signature::read_file(file_signature::default_output_file);
+
+    std::vector<int> hashes;
+    file_signature::generate(
+        data.data(), data.size(), 10,
+        [&hashes](const file_signature::block_digests& d) {
+          hashes.push_back(d.crc32);
+        });
+
+    ASSERT_EQ(lines.size(), hashes.size());
+    for (std::size_t i = 0; i < lines.size(); i++) {
+      EXPECT_EQ(lines[i], std::to_string(hashes[i]));
+    }
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+}
+
+TEST(Memory, ChunksSpanningBlocks) {
+  try {
+    auto data = test_data(1000);
+    file_signature::digest_set digests;
+    digests.crc32c = true;
+    digests.xxh64 = true;
+
+    auto expected = sign({{data.data(), data.size()}}, 64, digests);
+    ASSERT_EQ(16, expected.size());
+
+    std::vector<file_signature::memory_chunk> chunks;
+    for (std::size_t offset = 0, n = 1; offset < data.size(); n += 7) {
+      auto size = std::min(n % 100, data.size() - offset);
+      chunks.push_back({data.data() + offset, size});
+      offset += size;
+    }
+    auto actual = sign(chunks, 64, digests);
+
+    ASSERT_EQ(expected.size(), actual.size());
+    for (std::size_t i = 0; i < expected.size(); i++) {
+      EXPECT_EQ(expected[i].crc32, actual[i].crc32);
+      EXPECT_EQ(expected[i].crc32c, actual[i].crc32c);
+      EXPECT_EQ(expected[i].xxh64, actual[i].xxh64);
+    }
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+}
+
+TEST(Memory, Sha256) {
+  try {
+    auto data = test_data(100000);
+    file_signature::digest_set digests;
+    digests.sha256 = true;
+
+    file_signature::sha256 expected;
+    expected.update(data.data(), data.size());
+
+    auto hex = file_signature::generate(
+        {{data.data(), 3}, {data.data() + 3, data.size() - 3}}, 10,
+        [](const file_signature::block_digests&) {}, digests);
+    EXPECT_EQ(expected.hex_digest(), hex);
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+}
+
+TEST(Memory, Empty) {
+  try {
+    EXPECT_EQ(0, sign({}, 10, {}).size());
+    EXPECT_EQ(0, sign({{nullptr, 0}, {nullptr, 0}}, 10, {}).size());
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+}
+
+TEST(Memory, OutputBuffer) {
+  try {
+    auto data = test_data(95);
+    std::vector<file_signature::block_digests> out(10);
+
+    file_signature::generate(data.data(), data.size(), 10, out.data(),
+                             out.size());
+
+    for (std::size_t i = 0; i < out.size(); i++) {
+      auto size = std::min<std::size_t>(10, data.size() - i * 10);
+      EXPECT_EQ(file_signature::block_hash(data.data() + i * 10, size),
+                out[i].crc32);
+    }
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+}
+
+TEST(Memory, OutputBufferTooSmall) {
+  auto data = test_data(95);
+  std::vector<file_signature::block_digests> out(9);
+
+  try {
+    file_signature::generate(data.data(), data.size(), 10, out.data(),
+                             out.size());
+    FAIL() << "expected to throw an exception";
+  } catch (std::exception& e) {
+    SUCCEED();
+  }
+}
+
+TEST(Memory, SeveralRounds) {
+  try {
+    // digests go to the sink in rounds of 4096 blocks
+    auto data = test_data(4096 * 2 * 4 + 5);
+    file_signature::digest_set digests;
+    digests.xxh64 = true;
+    digests.sha256 = true;
+
+    std::vector<file_signature::block_digests> actual;
+    auto sha = file_signature::generate(
+        data.data(), data.size(), 4,
+        [&actual](const file_signature::block_digests& d) {
+          actual.push_back(d);
+        },
+        digests);
+
+    ASSERT_EQ(4096 * 2 + 2, actual.size());
+    for (std::size_t i = 0; i < actual.size(); i++) {
+      file_signature::block_hasher h{digests};
+      h.update(data.data() + i * 4,
+               std::min<std::size_t>(4, data.size() - i * 4));
+      auto expected = h.digests();
+      EXPECT_EQ(expected.crc32, actual[i].crc32) << i;
+      EXPECT_EQ(expected.xxh64, actual[i].xxh64) << i;
+    }
+
+    file_signature::sha256 file_sha256;
+    file_sha256.update(data.data(), data.size());
+    EXPECT_EQ(file_sha256.hex_digest(), sha);
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+}
@@ -0,0 +1,120 @@
+#include <file_signature/file_signature.h>
+
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Compares the throughput of generate() left to the scheduler with its
+// throughput pinned to every numa node. On a multi-socket machine the input
+// is best read once with numactl --membind on one node first, so that the
+// page cache is local to that node and remote to the others.
+
+namespace po = boost::program_options;
+
+namespace {
+
+void create_random_file(const std::string& name, std::uint64_t size) {
+  std::ofstream f(name, std::ios::binary | std::ios::trunc | std::ios::out);
+  std::mt19937_64 rng{1};
+  std::vector<std::uint64_t> chunk(1 << 17);
+
+  for (std::uint64_t written = 0; written < size;) {
+    for (auto& v : chunk) {
+      v = rng();
+    }
+    auto n = std::min<std::uint64_t>(chunk.size() * sizeof(chunk[0]),
+                                     size - written);
+    f.write(reinterpret_cast<const char*>(chunk.data()), n);
+    written += n;
+  }
+}
+
+// best of the runs, the first one may still fill the page cache; pinned is
+// false when a run couldn't be bound to numa_node
+double throughput(const std::string& input_file, int block_size,
+                  int numa_node, int runs, bool& pinned) {
+  double best = 0;
+  pinned = true;
+
+  for (int i = 0; i < runs; i++) {
+    file_signature::options opts;
+    opts.numa_node = numa_node;
+    file_signature::stats st;
+    file_signature::generate(input_file, "numa_bench.signature", block_size,
+                             opts, &st);
+    pinned = pinned && st.numa_node == numa_node;
+
+    if (st.seconds > 0) {
+      best = std::max(best, st.bytes / st.seconds / (1 << 20));
+    }
+  }
+
+  return best;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  po::options_description desc("Allowed options");
+  desc.add_options()("help", "produce help message")(
+      "input-file", po::value<std::string>(),
+      "file to sign, a random one is created when not given")(
+      "size", po::value<std::uint64_t>()->default_value(1ULL << 30),
+      "bytes of the random file")(
+      "block-size", po::value<int>()->default_value(1 << 20), "block size")(
+      "runs", po::value<int>()->default_value(3), "runs per placement");
+
+  po::variables_map opts;
+
+  try {
+    po::store(po::parse_command_line(argc, argv, desc), opts);
+    po::notify(opts);
+  } catch (std::exception& exc) {
+    std::cerr << exc.what() << "\n";
+    return 1;
+  }
+
+  if (opts.count("help")) {
+    std::cout << desc << "\n";
+    return 1;
+  }
+
+  try {
+    std::string input_file = "numa_bench.bin";
+    bool created = !opts.count("input-file");
+    if (created) {
+      create_random_file(input_file, opts["size"].as<std::uint64_t>());
+    } else {
+      input_file = opts["input-file"].as<std::string>();
+    }
+
+    auto block_size = opts["block-size"].as<int>();
+    auto runs = opts["runs"].as<int>();
+
+    bool pinned;
+    std::cout << "placement MiB/s\n";
+    std::cout << "none " << throughput(input_file, block_size, -1, runs, pinned)
+              << '\n';
+    for (const auto& n : file_signature::numa_topology()) {
+      std::cout << "node" << n.node << ' '
+                << throughput(input_file, block_size, n.node, runs, pinned)
+                << (pinned ? "" : " (not pinned)") << '\n';
+    }
+
+    std::filesystem::remove("numa_bench.signature");
+    if (created) {
+      std::filesystem::remove(input_file);
+    }
+  } catch (std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+}
@@ -0,0 +1,95 @@
+#include <file_signature/file_signature.h>
+#include <file_signature/file_signature_impl.h>
+
+#include <sched.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace file_signature {
+
+namespace {
+
+const char node_dir[] = "/sys/devices/system/node/";
+
+bool read_line(const std::string& name, std::string& line) {
+  std::ifstream s{name};
+  return static_cast<bool>(std::getline(s, line));
+}
+
+}  // namespace
+
+std::vector<int> parse_cpu_list(const std::string& list) {
+  std::vector<int> cpus;
+  std::istringstream s{list};
+  std::string range;
+
+  while (std::getline(s, range, ',')) {
+    if (range.empty() || range == "\n") {
+      continue;
+    }
+
+    try {
+      auto dash = range.find('-');
+      auto first = std::stoi(range.substr(0, dash));
+      auto last =
+          dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+
+      for (auto cpu = first; cpu <= last; cpu++) {
+        cpus.push_back(cpu);
+      }
+    } catch (std::exception& e) {
+      std::throw_with_nested(error("Couldn't parse cpu list " + list));
+    }
+  }
+
+  return cpus;
+}
+
+std::vector<numa_node_info> numa_topology() {
+  std::vector<numa_node_info> topology;
+
+  std::string online;
+  if (!read_line(std::string(node_dir) + "online", online)) {
+    return topology;
+  }
+
+  for (auto node : parse_cpu_list(online)) {
+    std::string cpulist;
+    read_line(std::string(node_dir) + "node" + std::to_string(node) +
+                  "/cpulist",
+              cpulist);
+    topology.push_back({node, parse_cpu_list(cpulist)});
+  }
+
+  return topology;
+}
+
+std::vector<int> numa_node_cpus(int node) {
+  for (auto& n : numa_topology()) {
+    if (n.node == node && !n.cpus.empty()) {
+      return std::move(n.cpus);
+    }
+  }
+
+  throw error("No cpus on numa node " + std::to_string(node));
+}
+
+bool bind_to_cpus(const std::vector<int>& cpus) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (auto cpu : cpus) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+
+  // placement is an optimization, the pipeline works on any cpu; a cpuset
+  // without the node's cpus fails with EINVAL
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+}  // namespace file_signature
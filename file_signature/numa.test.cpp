@@ -0,0 +1,86 @@
+#include <file_signature/file_signature.h>
+#include <file_signature/file_signature.test.h>
+#include <file_signature/file_signature_impl.h>
+#include <gtest/gtest.h>
+
+#include <sched.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// a cpuset-restricted container may refuse the cpus of a node
+bool can_bind(const std::vector<int>& cpus) {
+  bool bound = false;
+  std::thread{[&]() { bound = file_signature::bind_to_cpus(cpus); }}.join();
+  return bound;
+}
+
+}  // namespace
+
+TEST(Numa, ParseCpuList) {
+  EXPECT_EQ(std::vector<int>{}, file_signature::parse_cpu_list(""));
+  EXPECT_EQ(std::vector<int>{0}, file_signature::parse_cpu_list("0"));
+  EXPECT_EQ((std::vector<int>{0, 1, 2, 3, 8, 10, 11}),
+            file_signature::parse_cpu_list("0-3,8,10-11"));
+}
+
+TEST(Numa, ParseInvalidCpuList) {
+  try {
+    file_signature::parse_cpu_list("a-b");
+    FAIL() << "expected to throw an exception";
+  } catch (std::exception& e) {
+    SUCCEED();
+  }
+}
+
+TEST(Numa, GenerateOnNode) {
+  auto topology = file_signature::numa_topology();
+  if (topology.empty()) {
+    GTEST_SKIP() << "no numa topology in sysfs";
+  }
+
+  try {
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           20, 'c');
+
+    file_signature::options opts;
+    opts.numa_node = topology[0].node;
+    file_signature::stats st;
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10, opts,
+                             &st);
+
+    auto lines = file_signature::read_file(file_signature::default_output_file);
+    ASSERT_EQ(2, lines.size());
+    EXPECT_EQ(lines[0], lines[1]);
+    EXPECT_EQ(2, st.blocks);
+    EXPECT_EQ(20, st.bytes);
+    EXPECT_EQ(can_bind(topology[0].cpus) ? topology[0].node : -1,
+              st.numa_node);
+    EXPECT_EQ(topology.size(), st.topology.size());
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+}
+
+TEST(Numa, BindToMissingCpu) {
+  EXPECT_FALSE(can_bind({CPU_SETSIZE - 1}));
+}
+
+TEST(Numa, NotExistingNode) {
+  try {
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           20, 'c');
+
+    file_signature::options opts;
+    opts.numa_node = 100000;
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10, opts);
+    FAIL() << "expected to throw an exception";
+  } catch (std::exception& e) {
+    SUCCEED();
+  }
+}
@@ -0,0 +1,145 @@
+#include <file_signature/file_signature.h>
+#include <file_signature/file_signature_impl.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <ios>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace file_signature {
+
+namespace {
+
+std::vector<int> hash_blocks(int fd, int block_size, std::uint64_t file_size,
+                             const std::vector<std::uint64_t>& indices,
+                             std::size_t first, std::size_t last) {
+  std::vector<int> hashes;
+  std::vector<char> buffer(block_size);
+
+  for (auto i = first; i < last; i++) {
+    auto offset = indices[i] * block_size;
+    auto size = std::min<std::uint64_t>(block_size, file_size - offset);
+
+    std::size_t done = 0;
+    while (done < size) {
+      auto n = pread(fd, buffer.data() + done, size - done, offset + done);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        throw error(std::string("Couldn't read block ") +
+                    std::to_string(indices[i]) + ": " +
+                    (n < 0 ? std::strerror(errno) : "unexpected end of file"));
+      }
+      done += n;
+    }
+
+    hashes.push_back(block_hash(buffer.data(), size));
+  }
+
+  return hashes;
+}
+
+}  // namespace
+
+std::vector<std::uint64_t> sample_blocks(std::uint64_t blocks,
+                                         const sample_options& opts) {
+  std::vector<std::uint64_t> indices;
+  if (blocks == 0) {
+    return indices;
+  }
+
+  indices.push_back(0);
+  indices.push_back(blocks - 1);
+
+  if (opts.stride > 0) {
+    for (std::uint64_t i = opts.stride; i < blocks; i += opts.stride) {
+      indices.push_back(i);
+    }
+  }
+
+  for (std::uint64_t i = 0; i < opts.count; i++) {
+    indices.push_back(mix64(opts.seed + i) % blocks);
+  }
+
+  std::sort(indices.begin(), indices.end());
+  indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+  return indices;
+}
+
+void sample(std::string input_file, std::string signature_file,
+            int block_size, const sample_options& opts) {
+  try {
+    if (block_size <= 0) {
+      throw error("block size must be positive");
+    }
+
+    int fd = open(input_file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      throw error("Couldn't open " + input_file + ": " + std::strerror(errno));
+    }
+    std::shared_ptr<void> fd_closer{nullptr, [fd](void*) { close(fd); }};
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+      throw error("Couldn't stat " + input_file + ": " + std::strerror(errno));
+    }
+
+    std::uint64_t file_size = st.st_size;
+    auto indices =
+        sample_blocks((file_size + block_size - 1) / block_size, opts);
+
+    // the sampled blocks are spread over the file, reading them concurrently
+    // keeps several requests in flight
+    std::size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    workers = std::min(workers, indices.size());
+    std::vector<std::future<std::vector<int>>> results;
+    for (std::size_t w = 0; w < workers; w++) {
+      auto first = indices.size() * w / workers;
+      auto last = indices.size() * (w + 1) / workers;
+      results.push_back(std::async(std::launch::async, [&, first, last]() {
+        return hash_blocks(fd, block_size, file_size, indices, first, last);
+      }));
+    }
+
+    std::vector<int> hashes;
+    for (auto& r : results) {
+      auto h = r.get();
+      hashes.insert(hashes.end(), h.begin(), h.end());
+    }
+
+    std::ofstream s;
+    try {
+      s.exceptions(std::ifstream::badbit | std::ios_base::failbit);
+      s.open(signature_file, std::ios::trunc | std::ios::out);
+    } catch (std::exception& e) {
+      std::throw_with_nested(error("Couldn't open " + signature_file));
+    }
+
+    s << format_header({{"mode", "sampled"},
+                        {"block_size", std::to_string(block_size)},
+                        {"file_size", std::to_string(file_size)},
+                        {"stride", std::to_string(opts.stride)},
+                        {"count", std::to_string(opts.count)},
+                        {"seed", std::to_string(opts.seed)}})
+      << '\n';
+    for (std::size_t i = 0; i < indices.size(); i++) {
+      s << indices[i] << ' ' << hashes[i] << '\n';
+    }
+    s.close();
+  } catch (std::exception& e) {
+    std::throw_with_nested(error("sample error: " + input_file));
+  }
+}
+
+}  // namespace file_signature
@@ -0,0 +1,95 @@
+#include <file_signature/file_signature.h>
+#include <file_signature/file_signature.test.h>
+#include <file_signature/file_signature_impl.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+TEST(Sample, Blocks) {
+  file_signature::sample_options opts;
+  EXPECT_EQ(std::vector<std::uint64_t>{},
+            file_signature::sample_blocks(0, opts));
+  EXPECT_EQ(std::vector<std::uint64_t>{0},
+            file_signature::sample_blocks(1, opts));
+  EXPECT_EQ((std::vector<std::uint64_t>{0, 9}),
+            file_signature::sample_blocks(10, opts));
+
+  opts.stride = 4;
+  EXPECT_EQ((std::vector<std::uint64_t>{0, 4, 8, 9}),
+            file_signature::sample_blocks(10, opts));
+}
+
+TEST(Sample, SeededBlocksAreDeterministic) {
+  file_signature::sample_options opts;
+  opts.count = 5;
+  opts.seed = 7;
+
+  auto blocks = file_signature::sample_blocks(1000, opts);
+  EXPECT_EQ(blocks, file_signature::sample_blocks(1000, opts));
+  EXPECT_LE(blocks.size(), 7);
+  EXPECT_GE(blocks.size(), 3);
+
+  opts.seed = 8;
+  EXPECT_NE(blocks, file_signature::sample_blocks(1000, opts));
+}
+
+TEST(Sample, MatchesFullSignature) {
+  try {
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           95, 'c');
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10);
+    auto full = file_signature::read_file(file_signature::default_output_file);
+
+    file_signature::sample_options opts;
+    opts.stride = 3;
+    file_signature::sample(file_signature::default_input_file,
+                           "sample.signature", 10, opts);
+    auto lines = file_signature::read_file("sample.signature");
+
+    ASSERT_EQ(5, lines.size());
+
+    file_signature::signature_header h;
+    ASSERT_TRUE(file_signature::parse_header(lines[0], h));
+    EXPECT_EQ("sampled", h["mode"]);
+    EXPECT_EQ("10", h["block_size"]);
+    EXPECT_EQ("95", h["file_size"]);
+
+    EXPECT_EQ("0 " + full[0], lines[1]);
+    EXPECT_EQ("3 " + full[3], lines[2]);
+    EXPECT_EQ("6 " + full[6], lines[3]);
+    EXPECT_EQ("9 " + full[9], lines[4]);
+    EXPECT_NE(full[0], full[9]);
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+
+  file_signature::delete_file_for_reader("sample.signature");
+}
+
+TEST(Sample, EmptyFile) {
+  try {
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           0, 'c');
+    file_signature::sample(file_signature::default_input_file,
+                           file_signature::default_output_file, 10, {});
+
+    auto lines = file_signature::read_file(file_signature::default_output_file);
+    ASSERT_EQ(1, lines.size());
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+}
+
+TEST(Sample, NotExistingFile) {
+  try {
+    file_signature::delete_file_for_reader(file_signature::default_input_file);
+    file_signature::sample(file_signature::default_input_file,
+                           file_signature::default_output_file, 10, {});
+    FAIL() << "expected to throw an exception";
+  } catch (std::exception& e) {
+    SUCCEED();
+  }
+}
@@ -0,0 +1,147 @@
+#include <file_signature/file_signature.h>
+#include <file_signature/file_signature_impl.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace file_signature {
+
+namespace {
+
+std::uint64_t header_number(const signature_header& h, const std::string& key,
+                            const std::string& signature_file) {
+  auto i = h.find(key);
+  if (i == h.end()) {
+    throw error(signature_file + " has no " + key);
+  }
+
+  try {
+    return std::stoull(i->second);
+  } catch (std::exception& e) {
+    std::throw_with_nested(error(signature_file + " has invalid " + key));
+  }
+}
+
+struct shard {
+  std::string file;
+  std::uint64_t first_block;
+  std::uint64_t end_block;
+  signature sig;
+};
+
+}  // namespace
+
+signature_header shard_header(const std::string& input_file, int block_size,
+                              const options& opts) {
+  if (block_size <= 0) {
+    throw error("block size must be positive");
+  }
+
+  if (opts.offset % block_size != 0 || opts.length % block_size != 0) {
+    throw error("shard offset and length must be multiples of the block size");
+  }
+
+  if (opts.digests.sha256) {
+    throw error("sha256 of the whole file can't be computed by a shard");
+  }
+
+  auto id = stat_identity(input_file);
+  auto file_size = id.size;
+
+  auto end = opts.length > 0 ? std::min(file_size, opts.offset + opts.length)
+                             : file_size;
+  auto first_block = opts.offset / block_size;
+  auto end_block =
+      end > opts.offset ? (end + block_size - 1) / block_size : first_block;
+
+  return {{"mode", "shard"},
+          {"block_size", std::to_string(block_size)},
+          {"file_size", std::to_string(file_size)},
+          {"first_block", std::to_string(first_block)},
+          {"end_block", std::to_string(end_block)},
+          // shards of different versions of a file mustn't be merged
+          {"mtime_ns", std::to_string(id.mtime_ns)}};
+}
+
+void merge(const std::vector<std::string>& shard_files,
+           std::string signature_file) {
+  try {
+    std::vector<shard> shards;
+
+    for (const auto& f : shard_files) {
+      auto sig = read_signature(f);
+      if (sig.header["mode"] != "shard") {
+        throw error(f + " is not a shard signature");
+      }
+
+      auto first_block = header_number(sig.header, "first_block", f);
+      auto end_block = header_number(sig.header, "end_block", f);
+      if (end_block - first_block != sig.crc32.size()) {
+        throw error(f + " doesn't have a hash for every block of its range");
+      }
+
+      shards.push_back({f, first_block, end_block, std::move(sig)});
+    }
+
+    if (shards.empty()) {
+      throw error("no shards to merge");
+    }
+
+    std::sort(shards.begin(), shards.end(),
+              [](const shard& a, const shard& b) {
+                return a.first_block < b.first_block;
+              });
+
+    auto& first = shards.front().sig.header;
+    for (const auto& s : shards) {
+      for (auto key : {"block_size", "file_size", "mtime_ns", "digests"}) {
+        auto a = first.find(key);
+        auto b = s.sig.header.find(key);
+        if ((a == first.end()) != (b == s.sig.header.end()) ||
+            (a != first.end() && a->second != b->second)) {
+          throw error(s.file + " has a different " + key);
+        }
+      }
+    }
+
+    auto block_size = header_number(first, "block_size", shards.front().file);
+    auto file_size = header_number(first, "file_size", shards.front().file);
+    auto blocks = (file_size + block_size - 1) / block_size;
+
+    signature result;
+    std::uint64_t next_block = 0;
+    for (auto& s : shards) {
+      if (s.first_block != next_block) {
+        throw error(s.file + " starts at block " +
+                    std::to_string(s.first_block) + ", expected " +
+                    std::to_string(next_block));
+      }
+      next_block = s.end_block;
+
+      result.crc32.insert(result.crc32.end(), s.sig.crc32.begin(),
+                          s.sig.crc32.end());
+      result.crc32c.insert(result.crc32c.end(), s.sig.crc32c.begin(),
+                           s.sig.crc32c.end());
+      result.xxh64.insert(result.xxh64.end(), s.sig.xxh64.begin(),
+                          s.sig.xxh64.end());
+    }
+
+    if (next_block != blocks) {
+      throw error("shards end at block " + std::to_string(next_block) +
+                  ", the file has " + std::to_string(blocks));
+    }
+
+    auto digests = first.find("digests");
+    if (digests != first.end()) {
+      result.header = {{"mode", "full"}, {"digests", digests->second}};
+    }
+
+    write_signature(signature_file, result);
+  } catch (std::exception& e) {
+    std::throw_with_nested(error("merge error: " + signature_file));
+  }
+}
+
+}  // namespace file_signature
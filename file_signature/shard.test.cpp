@@ -0,0 +1,240 @@
+#include <file_signature/file_signature.h>
+#include <file_signature/file_signature.test.h>
+#include <file_signature/file_signature_impl.h>
+#include <gtest/gtest.h>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace {
+
+void sign_shard(const std::string& name, std::uint64_t offset,
+                std::uint64_t length,
+                file_signature::digest_set digests = {}) {
+  file_signature::options opts;
+  opts.digests = digests;
+  opts.shard = true;
+  opts.offset = offset;
+  opts.length = length;
+  file_signature::generate(file_signature::default_input_file, name, 10, opts);
+}
+
+// signs the shard in a child process, the way shards are signed on
+// separate hosts
+pid_t fork_shard(const std::string& name, std::uint64_t offset,
+                 std::uint64_t length) {
+  auto pid = ::fork();
+  if (pid == 0) {
+    try {
+      sign_shard(name, offset, length);
+    } catch (...) {
+      ::_exit(1);
+    }
+    ::_exit(0);
+  }
+  return pid;
+}
+
+bool wait_shard(pid_t pid) {
+  int status = 0;
+  return pid > 0 && ::waitpid(pid, &status, 0) == pid &&
+         WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+void delete_shards() {
+  for (auto name : {"shard1.signature", "shard2.signature",
+                    "shard3.signature", "merged.signature"}) {
+    file_signature::delete_file_for_reader(name);
+  }
+}
+
+}  // namespace
+
+TEST(Shard, Header) {
+  try {
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           95, 'c');
+    sign_shard("shard1.signature", 30, 40);
+
+    auto lines = file_signature::read_file("shard1.signature");
+    ASSERT_EQ(5, lines.size());
+
+    file_signature::signature_header h;
+    ASSERT_TRUE(file_signature::parse_header(lines[0], h));
+    EXPECT_EQ("shard", h["mode"]);
+    EXPECT_EQ("3", h["first_block"]);
+    EXPECT_EQ("7", h["end_block"]);
+    EXPECT_EQ("95", h["file_size"]);
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+
+  delete_shards();
+}
+
+TEST(Shard, MergeMatchesSingleRun) {
+  try {
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           95, 'c');
+    std::fstream f(file_signature::default_input_file,
+                   std::ios::binary | std::ios::in | std::ios::out);
+    f.seekp(42);
+    f << "different";
+    f.close();
+
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10);
+
+    auto s1 = fork_shard("shard1.signature", 60, 0);
+    auto s2 = fork_shard("shard2.signature", 0, 30);
+    auto s3 = fork_shard("shard3.signature", 30, 30);
+    ASSERT_TRUE(wait_shard(s1));
+    ASSERT_TRUE(wait_shard(s2));
+    ASSERT_TRUE(wait_shard(s3));
+
+    file_signature::merge(
+        {"shard1.signature", "shard2.signature", "shard3.signature"},
+        "merged.signature");
+
+    EXPECT_EQ(file_signature::read_file(file_signature::default_output_file),
+              file_signature::read_file("merged.signature"));
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+
+  delete_shards();
+}
+
+TEST(Shard, MergeWithDigests) {
+  try {
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           95, 'c');
+    file_signature::options opts;
+    opts.digests.crc32c = true;
+    opts.digests.xxh64 = true;
+    file_signature::generate(file_signature::default_input_file,
+                             file_signature::default_output_file, 10, opts);
+
+    sign_shard("shard1.signature", 0, 50, opts.digests);
+    sign_shard("shard2.signature", 50, 0, opts.digests);
+    file_signature::merge({"shard1.signature", "shard2.signature"},
+                          "merged.signature");
+
+    EXPECT_EQ(file_signature::read_file(file_signature::default_output_file),
+              file_signature::read_file("merged.signature"));
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+
+  delete_shards();
+}
+
+TEST(Shard, MergeDifferentVersions) {
+  file_signature::create_file_for_reader(file_signature::default_input_file,
+                                         95, 'c');
+  sign_shard("shard1.signature", 0, 50);
+
+  auto mtime =
+      std::filesystem::last_write_time(file_signature::default_input_file);
+  std::filesystem::last_write_time(file_signature::default_input_file,
+                                   mtime + std::chrono::seconds(1));
+  sign_shard("shard2.signature", 50, 0);
+
+  try {
+    file_signature::merge({"shard1.signature", "shard2.signature"},
+                          "merged.signature");
+    FAIL() << "expected to throw an exception";
+  } catch (std::exception& e) {
+    SUCCEED();
+  }
+
+  delete_shards();
+}
+
+TEST(Shard, MergeWithGap) {
+  file_signature::create_file_for_reader(file_signature::default_input_file,
+                                         95, 'c');
+  sign_shard("shard1.signature", 0, 30);
+  sign_shard("shard2.signature", 40, 0);
+
+  try {
+    file_signature::merge({"shard1.signature", "shard2.signature"},
+                          "merged.signature");
+    FAIL() << "expected to throw an exception";
+  } catch (std::exception& e) {
+    SUCCEED();
+  }
+
+  delete_shards();
+}
+
+TEST(Shard, MergeWithoutTail) {
+  file_signature::create_file_for_reader(file_signature::default_input_file,
+                                         95, 'c');
+  sign_shard("shard1.signature", 0, 30);
+  sign_shard("shard2.signature", 30, 30);
+
+  try {
+    file_signature::merge({"shard1.signature", "shard2.signature"},
+                          "merged.signature");
+    FAIL() << "expected to throw an exception";
+  } catch (std::exception& e) {
+    SUCCEED();
+  }
+
+  delete_shards();
+}
+
+TEST(Shard, MergeOverlap) {
+  file_signature::create_file_for_reader(file_signature::default_input_file,
+                                         95, 'c');
+  sign_shard("shard1.signature", 0, 50);
+  sign_shard("shard2.signature", 30, 0);
+
+  try {
+    file_signature::merge({"shard1.signature", "shard2.signature"},
+                          "merged.signature");
+    FAIL() << "expected to throw an exception";
+  } catch (std::exception& e) {
+    SUCCEED();
+  }
+
+  delete_shards();
+}
+
+TEST(Shard, ZeroBlockSize) {
+  file_signature::create_file_for_reader(file_signature::default_input_file,
+                                         95, 'c');
+  file_signature::options opts;
+  opts.shard = true;
+
+  try {
+    file_signature::generate(file_signature::default_input_file,
+                             "shard1.signature", 0, opts);
+    FAIL() << "expected to throw an exception";
+  } catch (std::exception& e) {
+    SUCCEED();
+  }
+
+  delete_shards();
+}
+
+TEST(Shard, UnalignedOffset) {
+  file_signature::create_file_for_reader(file_signature::default_input_file,
+                                         95, 'c');
+
+  try {
+    sign_shard("shard1.signature", 5, 0);
+    FAIL() << "expected to throw an exception";
+  } catch (std::exception& e) {
+    SUCCEED();
+  }
+
+  delete_shards();
+}
@@ -0,0 +1,241 @@
+#include <file_signature/file_signature.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace file_signature {
+
+namespace {
+
+constexpr std::uint32_t watch_mask =
+    IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO;
+
+std::string system_error(const std::string& what) {
+  return what + ": " + std::strerror(errno);
+}
+
+}  // namespace
+
+//
+// watcher
+//
+
+constexpr std::chrono::milliseconds watcher::settle_time;
+
+watcher::watcher(const std::vector<std::string>& input_files,
+                 const std::vector<std::string>& signature_files,
+                 int block_size, error_handler on_error)
+    : block_size{block_size},
+      on_error{std::move(on_error)},
+      inotify_fd{-1},
+      stop_fds{-1, -1},
+      updates_{0} {
+  if (input_files.size() != signature_files.size()) {
+    throw error("watch error: every input file needs a signature file");
+  }
+
+  inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd < 0) {
+    throw error(system_error("inotify_init1"));
+  }
+
+  if (pipe2(stop_fds, O_NONBLOCK | O_CLOEXEC) < 0) {
+    close(inotify_fd);
+    throw error(system_error("pipe2"));
+  }
+
+  try {
+    for (std::size_t i = 0; i < input_files.size(); i++) {
+      std::filesystem::path p{input_files[i]};
+      target t;
+      t.input_file = input_files[i];
+      t.signature_file = signature_files[i];
+      t.dir = p.has_parent_path() ? p.parent_path().string() : ".";
+      t.name = p.filename().string();
+
+      // the directory is watched so that files replaced by rename are seen
+      bool watched = false;
+      for (const auto& w : watches) {
+        watched = watched || w.second == t.dir;
+      }
+
+      if (!watched) {
+        auto wd = inotify_add_watch(inotify_fd, t.dir.c_str(), watch_mask);
+        if (wd < 0) {
+          throw error(system_error("Couldn't watch " + t.dir));
+        }
+        watches.emplace_back(wd, t.dir);
+      }
+
+      targets.push_back(std::move(t));
+    }
+  } catch (...) {
+    close(inotify_fd);
+    close(stop_fds[0]);
+    close(stop_fds[1]);
+    throw;
+  }
+}
+
+watcher::~watcher() {
+  close(inotify_fd);
+  close(stop_fds[0]);
+  close(stop_fds[1]);
+}
+
+void watcher::stop() {
+  char c = 0;
+  auto r = write(stop_fds[1], &c, 1);
+  (void)r;
+}
+
+void watcher::run() {
+  for (auto& t : targets) {
+    update(t);
+  }
+
+  while (true) {
+    // until the earliest dirty input has been quiet for settle_time
+    int timeout = -1;
+    auto now = std::chrono::steady_clock::now();
+    for (const auto& t : targets) {
+      if (t.dirty) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        t.last_write + settle_time - now)
+                        .count();
+        left = std::max<decltype(left)>(left, 0);
+        timeout = timeout < 0 ? left : std::min<int>(timeout, left);
+      }
+    }
+
+    pollfd fds[2] = {{stop_fds[0], POLLIN, 0}, {inotify_fd, POLLIN, 0}};
+    if (poll(fds, 2, timeout) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw error(system_error("poll"));
+    }
+
+    if (fds[0].revents & POLLIN) {
+      char c;
+      while (read(stop_fds[0], &c, 1) > 0) {
+      }
+      return;
+    }
+
+    if (fds[1].revents & POLLIN) {
+      read_events();
+    }
+
+    now = std::chrono::steady_clock::now();
+    for (auto& t : targets) {
+      if (t.dirty && now - t.last_write >= settle_time) {
+        update(t);
+      }
+    }
+  }
+}
+
+void watcher::read_events() {
+  alignas(inotify_event) char buffer[4096];
+
+  while (true) {
+    auto n = read(inotify_fd, buffer, sizeof(buffer));
+    if (n <= 0) {
+      if (n < 0 && errno != EAGAIN && errno != EINTR) {
+        throw error(system_error("inotify read"));
+      }
+      return;
+    }
+
+    for (char* p = buffer; p < buffer + n;) {
+      auto* e = reinterpret_cast<inotify_event*>(p);
+      p += sizeof(inotify_event) + e->len;
+
+      // events were dropped, any input may have changed
+      if (e->mask & IN_Q_OVERFLOW) {
+        for (auto& t : targets) {
+          t.dirty = true;
+          t.last_write = std::chrono::steady_clock::now();
+        }
+        continue;
+      }
+
+      if (e->len == 0) {
+        continue;
+      }
+
+      std::string dir;
+      for (const auto& w : watches) {
+        if (w.first == e->wd) {
+          dir = w.second;
+        }
+      }
+
+      for (auto& t : targets) {
+        if (t.dir != dir || t.name != e->name) {
+          continue;
+        }
+
+        if (e->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+          update(t);
+        } else {
+          t.dirty = true;
+          t.last_write = std::chrono::steady_clock::now();
+        }
+      }
+    }
+  }
+}
+
+void watcher::update(target& t) {
+  t.dirty = false;
+
+  try {
+    struct stat before;
+    if (::stat(t.input_file.c_str(), &before) < 0) {
+      throw error(system_error("Couldn't stat " + t.input_file));
+    }
+
+    std::int64_t mtime_ns = before.st_mtim.tv_sec * 1000000000LL +
+                            before.st_mtim.tv_nsec;
+    if (t.known && t.size == static_cast<std::uint64_t>(before.st_size) &&
+        t.mtime_ns == mtime_ns) {
+      return;
+    }
+
+    auto tmp_file = t.signature_file + ".tmp";
+    generate(t.input_file, tmp_file, block_size);
+    std::filesystem::rename(tmp_file, t.signature_file);
+    updates_++;
+
+    // a write that raced with signing leaves the target unknown, the next
+    // event signs it again
+    struct stat after;
+    t.known = ::stat(t.input_file.c_str(), &after) == 0 &&
+              after.st_size == before.st_size &&
+              after.st_mtim.tv_sec == before.st_mtim.tv_sec &&
+              after.st_mtim.tv_nsec == before.st_mtim.tv_nsec;
+    t.size = before.st_size;
+    t.mtime_ns = mtime_ns;
+  } catch (const std::exception& e) {
+    t.known = false;
+    if (on_error) {
+      on_error(e);
+    }
+  }
+}
+
+}  // namespace file_signature
@@ -0,0 +1,126 @@
+#include <file_signature/file_signature.h>
+#include <file_signature/file_signature.test.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <string>
+#include <thread>
+
+namespace {
+
+bool wait_for_updates(const file_signature::watcher& w, std::uint64_t n) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (w.updates() < n) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return true;
+}
+
+}  // namespace
+
+TEST(Watch, StartStop) {
+  try {
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           10, 'c');
+    file_signature::delete_file_for_reader(file_signature::default_output_file);
+
+    file_signature::watcher w{{file_signature::default_input_file},
+                              {file_signature::default_output_file},
+                              10};
+    auto watcher_result = std::async(std::launch::async, [&]() { w.run(); });
+
+    ASSERT_TRUE(wait_for_updates(w, 1));
+    w.stop();
+
+    watcher_result.wait();
+    watcher_result.get();
+
+    auto lines = file_signature::read_file(file_signature::default_output_file);
+    ASSERT_EQ(1, lines.size());
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+}
+
+TEST(Watch, ResignsChangedFile) {
+  try {
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           10, 'c');
+
+    file_signature::watcher w{{file_signature::default_input_file},
+                              {file_signature::default_output_file},
+                              10};
+    auto watcher_result = std::async(std::launch::async, [&]() { w.run(); });
+
+    ASSERT_TRUE(wait_for_updates(w, 1));
+
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           30, 'c');
+    ASSERT_TRUE(wait_for_updates(w, 2));
+
+    w.stop();
+    watcher_result.wait();
+    watcher_result.get();
+
+    auto lines = file_signature::read_file(file_signature::default_output_file);
+    ASSERT_EQ(3, lines.size());
+    EXPECT_EQ(lines[0], lines[2]);
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+}
+
+TEST(Watch, ResignsChangedAndGrownFile) {
+  try {
+    file_signature::create_file_for_reader(file_signature::default_input_file,
+                                           30, 'c');
+
+    file_signature::watcher w{{file_signature::default_input_file},
+                              {file_signature::default_output_file},
+                              10};
+    auto watcher_result = std::async(std::launch::async, [&]() { w.run(); });
+
+    ASSERT_TRUE(wait_for_updates(w, 1));
+
+    // the first and the last old blocks are unchanged
+    {
+      std::fstream f(file_signature::default_input_file,
+                     std::ios::binary | std::ios::in | std::ios::out);
+      f.seekp(10);
+      f << std::string(10, 'x');
+      f.seekp(0, std::ios::end);
+      f << std::string(10, 'd');
+    }
+    ASSERT_TRUE(wait_for_updates(w, 2));
+
+    w.stop();
+    watcher_result.wait();
+    watcher_result.get();
+
+    auto lines = file_signature::read_file(file_signature::default_output_file);
+    file_signature::generate(file_signature::default_input_file,
+                             "watch_full.signature", 10);
+    EXPECT_EQ(file_signature::read_file("watch_full.signature"), lines);
+    EXPECT_EQ(4, lines.size());
+  } catch (std::exception& e) {
+    FAIL() << e.what();
+  }
+
+  file_signature::delete_file_for_reader("watch_full.signature");
+}
+
+TEST(Watch, NotExistingDirectory) {
+  try {
+    file_signature::watcher w{{"not_existing_dir/test.txt"},
+                              {file_signature::default_output_file},
+                              10};
+    FAIL() << "expected to throw an exception";
+  } catch (std::exception& e) {
+    SUCCEED();
+  }
+}